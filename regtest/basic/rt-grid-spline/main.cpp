@@ -0,0 +1,50 @@
+#include "plumed/tools/Grid.h"
+#include "plumed/tools/File.h"
+#include <cmath>
+#include <string>
+#include <vector>
+
+using namespace PLMD;
+
+// Spline interpolation on grids with 1 to 5 dimensions, mixing periodic and
+// non periodic variables. Dimensions up to 4 use the specialised kernels,
+// 5 uses the generic code.
+
+int main(){
+  OFile out; out.open("output");
+
+  for(unsigned dim=1;dim<=5;++dim){
+    std::vector<std::string> names(dim),gmin(dim),gmax(dim),pmin(dim),pmax(dim);
+    std::vector<unsigned> nbin(dim);
+    std::vector<bool> pbc(dim);
+    for(unsigned j=0;j<dim;++j){
+      names[j]="x"+std::to_string(j);
+      pbc[j]=(j%2==0);
+      gmin[j]=pmin[j]="-3.0"; gmax[j]=pmax[j]="3.0";
+      nbin[j]=(dim<5 ? 23-2*dim : 6);
+    }
+    Grid grid("f",names,gmin,gmax,nbin,true,true,true,pbc,pmin,pmax);
+
+    std::vector<double> xx(dim),der(dim);
+    for(Grid::index_t i=0;i<grid.getSize();++i){
+      grid.getPoint(i,xx);
+      double f=1.0;
+      for(unsigned j=0;j<dim;++j) f*=std::cos(0.5*xx[j]+0.1*j)+1.5;
+      for(unsigned j=0;j<dim;++j) der[j]=-0.5*std::sin(0.5*xx[j]+0.1*j)*f/(std::cos(0.5*xx[j]+0.1*j)+1.5);
+      grid.setValueAndDerivatives(i,f,der);
+    }
+
+    out.printf("dimension %u\n",dim);
+    for(unsigned k=0;k<7;++k){
+      for(unsigned j=0;j<dim;++j) xx[j]=-2.95+std::fmod(0.83*k+0.37*j,5.9);
+      double f=grid.getValueAndDerivatives(xx,der);
+      double g=grid.getValue(xx);
+      out.printf("%12.8f %12.8f",f,g);
+      for(unsigned j=0;j<dim;++j) out.printf(" %12.8f",der[j]);
+      out.printf("\n");
+    }
+  }
+
+  out.close();
+  return 0;
+}
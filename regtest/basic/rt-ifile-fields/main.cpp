@@ -0,0 +1,89 @@
+#include "plumed/tools/File.h"
+#include "plumed/tools/Tools.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace PLMD;
+
+// Fields read with IFile::scanField(double) must be identical, bit by bit,
+// to the result of Tools::convert on the same string.
+// A HILLS-like file is written with several formats and read back.
+
+static unsigned long long seed=12345;
+static double rnd(){
+  seed=seed*6364136223846793005ULL+1442695040888963407ULL;
+  return (seed>>11)*(1.0/9007199254740992.0);
+}
+
+int main(){
+  const unsigned nlines=100000;
+  const char* special[]={"pi","-pi","2pi","NAN","1e400","-1e-400","4.9e-324","0x1p3","inf","1.5.3","+7","-0.0",".5","5.","1e+05","12345678901234567890123"};
+  const unsigned nspecial=sizeof(special)/sizeof(special[0]);
+
+  {
+    OFile of; of.open("hills");
+    of.addConstantField("multivariate").printField("multivariate","false");
+    for(unsigned i=0;i<nlines;++i){
+      double x=(rnd()-0.5)*std::pow(10.0,int(rnd()*24)-12);
+      of.printField("time",0.002*i);
+      of.fmtField(" %14.9f"); of.printField("x",x);
+      of.fmtField(" %23.16lg"); of.printField("y",x*std::sqrt(3.0));
+      of.fmtField(" %e"); of.printField("sigma",rnd()*1e-3);
+      of.fmtField(" %g"); of.printField("height",rnd());
+      of.fmtField(); of.printField("biasf",rnd()*100.0);
+      of.printField("n",int(i)-50000);
+      if(i%97==0) of.printField("s",std::string(" ")+special[(i/97)%nspecial]);
+      else of.printField("s",0.25*i);
+      of.printField();
+    }
+    of.close();
+  }
+
+  const char* names[]={"time","x","y","sigma","height","biasf","s"};
+  const unsigned nnames=sizeof(names)/sizeof(names[0]);
+
+  std::vector<double> sum(nnames,0.0);
+  unsigned nread=0;
+  {
+    IFile ifile; ifile.open("hills");
+    double v; int n; std::string mv;
+    while(ifile.scanField(names[0],v)){
+      sum[0]+=v;
+      for(unsigned j=1;j<nnames;++j){ ifile.scanField(names[j],v); if(std::fabs(v)<1e300) sum[j]+=v; }
+      ifile.scanField("n",n);
+      ifile.scanField("multivariate",mv);
+      ifile.scanField();
+      nread++;
+    }
+  }
+
+  unsigned mismatches=0;
+  {
+    IFile ifile; ifile.open("hills");
+    double v; std::string str; int n;
+    while(ifile.scanField(names[0],str)){
+      for(unsigned j=0;j<nnames;++j){
+        ifile.scanField(names[j],str);
+        double ref=0.0; Tools::convert(str,ref);
+        ifile.scanField(names[j],v);
+        if(std::memcmp(&v,&ref,sizeof(double))!=0){
+          if(mismatches<10) std::printf("mismatch reading %s: %s\n",names[j],str.c_str());
+          mismatches++;
+        }
+      }
+      ifile.scanField("n",n);
+      ifile.allowIgnoredFields();
+      ifile.scanField();
+    }
+  }
+
+  OFile out; out.open("output");
+  out.printf("lines read: %u\n",nread);
+  out.printf("mismatches: %u\n",mismatches);
+  for(unsigned j=0;j<nnames;++j) out.printf("sum of %s: %.10e\n",names[j],sum[j]);
+  out.close();
+  return 0;
+}
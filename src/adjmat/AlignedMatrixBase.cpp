@@ -98,7 +98,7 @@ double AlignedMatrixBase::compute( const unsigned& tindex, multicolvar::AtomValu
                                         distance, orient0, orient1, ddistance, dorient0, dorient1 );
 
   // Retrieve the weight of the connection
-  double dfunc, sw = switchingFunction( getBaseColvarNumber( myatoms.getIndex(0) ), getBaseColvarNumber( myatoms.getIndex(1) )-ncol_t ).calculate( distance.modulo(), dfunc ); 
+  double dfunc, sw = switchingFunction( getBaseColvarNumber( myatoms.getIndex(0) ), getBaseColvarNumber( myatoms.getIndex(1) )-ncol_t ).calculateSqr( distance.modulo2(), dfunc ); 
 
   if( !doNotCalculateDerivatives() ){
       addAtomDerivatives( 1, 0, (-dfunc)*f_dot*distance - sw*ddistance, myatoms );
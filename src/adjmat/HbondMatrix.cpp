@@ -26,6 +26,7 @@
 #include "tools/HistogramBead.h"
 #include "tools/Angle.h"
 #include "tools/Matrix.h"
+#include <algorithm>
 
 //+PLUMEDOC MATRIX HBOND_MATRIX
 /*
@@ -61,7 +62,8 @@ public:
   double compute( const unsigned& tindex, multicolvar::AtomValuePack& myatoms ) const ;
 ///
   double calculateForThree( const unsigned& iat, const unsigned& ano, const unsigned& dno, const Vector& ood,
-                            const double& ood_df , const double& ood_sw, multicolvar::AtomValuePack& myatoms ) const ;
+                            const double& ood_df , const double& ood_sw, const double& ohd_df, const double& ohd_sw,
+                            multicolvar::AtomValuePack& myatoms ) const ;
 };
 
 PLUMED_REGISTER_ACTION(HBondMatrix,"HBOND_MATRIX")
@@ -148,30 +150,35 @@ double HBondMatrix::calculateWeight( const unsigned& taskCode, const double& wei
 }
 
 double HBondMatrix::compute( const unsigned& tindex, multicolvar::AtomValuePack& myatoms ) const {
-  Vector ood = getSeparation( myatoms.getPosition(0), myatoms.getPosition(1) ); double ood_l = ood.modulo(); // acceptor - donor
+  Vector ood = getSeparation( myatoms.getPosition(0), myatoms.getPosition(1) ); // acceptor - donor
   double ood_df, ood_sw=distanceOOSwitch( getBaseColvarNumber( myatoms.getIndex(0) ),
-                                          getBaseColvarNumber( myatoms.getIndex(1) ) ).calculate( ood_l, ood_df );
+                                          getBaseColvarNumber( myatoms.getIndex(1) ) ).calculateSqr( ood.modulo2(), ood_df );
 
   // Get the base colvar numbers
   unsigned ano, dno = getBaseColvarNumber( myatoms.getIndex(0) );
   if( ndonor_types==0 ) ano = getBaseColvarNumber( myatoms.getIndex(1) );
   else ano = getBaseColvarNumber( myatoms.getIndex(1) ) - ndonor_types;
 
+  // The switching functions of the OH distances are computed in chunks with a single call
+  const SwitchingFunction& ohSwitch=distanceOHSwitch( getBaseColvarNumber( myatoms.getIndex(0) ),
+                                                      getBaseColvarNumber( myatoms.getIndex(1) ) );
+  const unsigned chunk=64; double d2[chunk], ohd_sw[chunk], ohd_df[chunk];
+  const unsigned natoms=myatoms.getNumberOfAtoms();
+  plumed_dbg_assert( natoms>=3 );
   double value=0;
-  if( myatoms.getNumberOfAtoms()>3 ){
-      for(unsigned i=2;i<myatoms.getNumberOfAtoms();++i) value+=calculateForThree( i, ano, dno, ood, ood_df, ood_sw,  myatoms );
-  } else {
-      plumed_dbg_assert( myatoms.getNumberOfAtoms()==3 );
-      value=calculateForThree( 2, ano, dno, ood, ood_df, ood_sw, myatoms );
+  for(unsigned i0=2;i0<natoms;i0+=chunk){
+      const unsigned n=std::min( chunk, natoms-i0 );
+      for(unsigned k=0;k<n;++k) d2[k]=getSeparation( myatoms.getPosition(0), myatoms.getPosition(i0+k) ).modulo2();
+      ohSwitch.calculateSqr( d2, ohd_sw, ohd_df, n );
+      for(unsigned k=0;k<n;++k) value+=calculateForThree( i0+k, ano, dno, ood, ood_df, ood_sw, ohd_df[k], ohd_sw[k], myatoms );
   }
   return value;
 }
 
 double HBondMatrix::calculateForThree( const unsigned& iat, const unsigned& ano, const unsigned& dno, const Vector& ood,
-                                       const double& ood_df , const double& ood_sw, multicolvar::AtomValuePack& myatoms ) const {
-  Vector ohd=getSeparation( myatoms.getPosition(0), myatoms.getPosition(iat) ); double ohd_l=ohd.modulo();
-  double ohd_df, ohd_sw=distanceOHSwitch( getBaseColvarNumber( myatoms.getIndex(0) ),
-                                          getBaseColvarNumber( myatoms.getIndex(1) ) ).calculate( ohd_l, ohd_df );
+                                       const double& ood_df , const double& ood_sw, const double& ohd_df, const double& ohd_sw,
+                                       multicolvar::AtomValuePack& myatoms ) const {
+  Vector ohd=getSeparation( myatoms.getPosition(0), myatoms.getPosition(iat) );
 
   Angle a; Vector ood_adf, ohd_adf; double angle=a.compute( ood, ohd, ood_adf, ohd_adf );
   double angle_df, angle_sw=angleSwitch( getBaseColvarNumber( myatoms.getIndex(0) ),
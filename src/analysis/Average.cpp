@@ -99,6 +99,7 @@ public:
   void apply(){}
   void performOperations( const bool& from_update );
   void finishAveraging();
+  void readCheckpoint( std::istream& );
   bool isPeriodic(){ return false; } 
   void performTask( const unsigned& , const unsigned& , MultiValue& ) const { plumed_error(); }
 };
@@ -138,5 +139,11 @@ void Average::finishAveraging(){
    setValue( myaverage->getAverage() );
 }
 
+void Average::readCheckpoint( std::istream& i ){
+   ActionWithAveraging::readCheckpoint( i );
+   // the value is otherwise only set at the next averaging step
+   setValue( myaverage->getAverage() );
+}
+
 }
 }
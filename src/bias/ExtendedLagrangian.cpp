@@ -131,6 +131,8 @@ public:
   explicit ExtendedLagrangian(const ActionOptions&);
   void calculate();
   void update();
+  void writeCheckpoint(std::ostream&)const;
+  void readCheckpoint(std::istream&);
   static void registerKeywords(Keywords& keys);
 };
 
@@ -270,6 +272,24 @@ void ExtendedLagrangian::update(){
   }
 }
 
+void ExtendedLagrangian::writeCheckpoint(std::ostream&o)const{
+  Tools::writeBinary(o,firsttime);
+  Tools::writeBinary(o,fict);
+  Tools::writeBinary(o,vfict);
+  Tools::writeBinary(o,vfict_laststep);
+  Tools::writeBinary(o,ffict);
+  rand.writeBinary(o);
+}
+
+void ExtendedLagrangian::readCheckpoint(std::istream&i){
+  Tools::readBinary(i,firsttime);
+  Tools::readBinary(i,fict);
+  Tools::readBinary(i,vfict);
+  Tools::readBinary(i,vfict_laststep);
+  Tools::readBinary(i,ffict);
+  rand.readBinary(i);
+}
+
 }
 
 }
@@ -29,6 +29,7 @@
 #include "core/FlexibleBin.h"
 #include "tools/Matrix.h"
 #include "tools/Random.h"
+#include "tools/OpenMP.h"
 #include <string>
 #include <cstring>
 #include "tools/File.h"
@@ -87,7 +88,9 @@ This default choice should be reasonable for most applications.
 
 Metadynamics can be restarted either from a HILLS file as well as from a GRID, in this second
 case one can first save a GRID using GRID_WFILE (and GRID_WSTRIDE) and at a later stage read
-it using GRID_RFILE.
+it using GRID_RFILE. With GRID_WBINARY the grid is written in a binary format, which is
+much faster to write and to read back for large grids. Binary grids are recognized
+automatically by GRID_RFILE and can be converted to text with \ref convert_grid.
 
 Another option that is available in plumed is well-tempered metadynamics \cite Barducci:2008. In this
 varient of metadynamics the heights of the Gaussian hills are rescaled at each step so the bias is now
@@ -231,6 +234,29 @@ where all the walkers are located. WALKERS_RSTRIDE is the number of step between
 one update and the other. Since version 2.2.5, hills files are automatically
 flushed every WALKERS_RSTRIDE steps.
 
+\par
+With many walkers on a parallel file system, reading the hills files of all the other walkers
+every WALKERS_RSTRIDE steps can be expensive. With the flag WALKERS_BINARY, each walker also
+writes its hills in a binary file with the same name as the hills file followed by ".bin".
+These files only contain fixed-size records, one per hill, and each walker keeps them open
+and reads only the records that have been appended since the last read.
+The HILLS files are still written, but they are not flushed every WALKERS_RSTRIDE steps anymore.
+When restarting, the hills of the other walkers are read from their HILLS files and the records
+already present in their binary files are not read again, except for those that are missing from
+the HILLS files (e.g. after a crash). Binary files that do not exist yet are read from the beginning
+once they are created, so that a run with WALKERS_BINARY can be restarted from a run without it.
+Since hills are exchanged with full precision, results can be slightly different from those obtained
+when they are exchanged through the HILLS files, which are written with a finite number of digits.
+All the walkers should use WALKERS_BINARY.
+
+\par
+With the flag WALKERS_MPI, walkers are instead simulations run with the --multi option of the MD engine
+and hills are exchanged through MPI, so that no file has to be read. By default all the walkers send
+their hills at every deposition. If WALKERS_RSTRIDE is also given, each walker adds its own hills
+as soon as they are deposited and the hills of all the walkers are exchanged with a single communication
+every WALKERS_RSTRIDE steps. Hills deposited after the last exchange are not written on the HILLS file.
+In all cases, walkers should use the same PACE.
+
 \par
 The c(t) reweighting factor can be calculated on the fly using the equations
 presented in \cite Tiwary_jp504920s as described above.
@@ -349,11 +375,30 @@ private:
   vector<double> sigma0_;
   vector<double> sigma0min_;
   vector<double> sigma0max_;
-  vector<Gaussian> hills_;
+// hills used when GRID is not active. They are stored as structure of arrays in blocks of
+// at most hillBlockSize_ hills of the same kind (multivariate or not). Quantity k of hill h
+// of block b is stored at [(b*nk+k)*hillBlockSize_+h], where nk is the number of quantities
+  static const unsigned hillBlockSize_=64;
+  unsigned nhills_;
+  vector<double> hillsCenter_;   // nk=ncv
+  vector<double> hillsInvSigma_; // nk=ncv*(ncv+1)/2, inverse sigmas or packed inverse covariance
+  vector<double> hillsHeight_;   // nk=1
+  vector<unsigned> blockFirst_;  // index of the first hill of each block
+  vector<unsigned> blockSize_;
+  vector<bool> blockMultivariate_;
+// bounding box of the centers of each block, and smallest inverse sigma (or lower bound
+// of the eigenvalues of the inverse covariance for multivariate hills) along each cv
+  vector<double> blockLower_;
+  vector<double> blockUpper_;
+  vector<double> blockMinInvSigma_;
+  vector<bool> periodic_;
+  vector<double> period_;
+  vector<double> invPeriod_;
   OFile hillsOfile_;
   OFile gridfile_;
   Grid* BiasGrid_;
   bool storeOldGrids_;
+  bool binaryGrids_;
   int wgridstride_; 
   bool grid_;
   double height0_;
@@ -374,10 +419,21 @@ private:
   bool walkers_mpi;
   unsigned mpi_nw_;
   unsigned mpi_mw_;
+/// records of the hills deposited by this walker and not yet sent to the other walkers
+  vector<double> mpiPending_;
+  unsigned mpiPendingCount_;
   bool acceleration;
   double acc;
   vector<IFile*> ifiles;
   vector<string> ifilesnames;
+/// true if hills are exchanged between walkers through binary files
+  bool walkersBinary_;
+/// binary file where the hills of this walker are written
+  OFile walkersBinaryOfile_;
+/// binary files of the other walkers, only open on the first process of the group
+  vector<FILE*> walkersBinaryFiles_;
+/// data of incomplete records read from the binary files of the other walkers
+  vector<vector<char> > walkersBinaryPending_;
   double uppI_;
   double lowI_;
   bool doInt_;
@@ -385,13 +441,26 @@ private:
   double reweight_factor;
   vector<unsigned> rewf_grid_; 
   unsigned rewf_ustride_;
+/// exp(afactor*bias) and exp(afactor2*bias) on the reweighting points owned by this rank
+  vector<double> rewf_exp1_,rewf_exp2_;
+/// lattice boxes (lower and upper index per CV) where the bias changed since the last c(t)
+  vector<int> rewf_boxes_;
   double work_;
   long int last_step_warn_grid;
  
-  void   readGaussians(IFile*);
+  unsigned readGaussians(IFile*);
   bool   readChunkOfGaussians(IFile *ifile, unsigned n);
   void   writeGaussian(const Gaussian&,OFile&);
+  unsigned getHillRecordSize()const;
+  void   writeHillRecord(const Gaussian&);
+  unsigned readHillRecords(unsigned walker,unsigned skip=0);
+  void   packHillRecord(const Gaussian&,vector<double>&)const;
+  Gaussian unpackHillRecord(const double*)const;
+  void   exchangeHillsMPI();
   void   addGaussian(const Gaussian&);
+  void   addSeparableGaussian(const Gaussian&);
+  void   storeHill(const Gaussian&);
+  double evaluateHills(const double* cv,double* der);
   double getHeight(const vector<double>&);
   double getBiasAndDerivatives(const vector<double>&,double* der=NULL);
   double evaluateGaussian(const vector<double>&, const Gaussian&,double* der=NULL);
@@ -399,6 +468,7 @@ private:
   vector<unsigned> getGaussianSupport(const Gaussian&);
   bool   scanOneHill(IFile *ifile,  vector<Value> &v, vector<double> &center, vector<double>  &sigma, double &height, bool &multivariate);
   void   computeReweightingFactor();
+  void   markReweightingSupport(const Gaussian&);
   string fmt;
 
 public:
@@ -406,6 +476,8 @@ public:
   ~MetaD();
   void calculate();
   void update();
+  void writeCheckpoint(std::ostream&)const;
+  void readCheckpoint(std::istream&);
   static void registerKeywords(Keywords& keys);
   bool checkNeedsGradients()const{if(adaptive_==FlexibleBin::geometry){return true;}else{return false;}}
 };
@@ -447,15 +519,17 @@ void MetaD::registerKeywords(Keywords& keys){
   keys.add("optional","GRID_WFILE","the file on which to write the grid");
   keys.add("optional","GRID_RFILE","a grid file from which the bias should be read at the initial step of the simulation");
   keys.addFlag("STORE_GRIDS",false,"store all the grid files the calculation generates. They will be deleted if this keyword is not present");
+  keys.addFlag("GRID_WBINARY",false,"write the grid files in binary format");
   keys.add("optional","ADAPTIVE","use a geometric (=GEOM) or diffusion (=DIFF) based hills width scheme. Sigma is one number that has distance units or timestep dimensions");
   keys.add("optional","WALKERS_ID", "walker id");
   keys.add("optional","WALKERS_N", "number of walkers");
   keys.add("optional","WALKERS_DIR", "shared directory with the hills files from all the walkers");
   keys.add("optional","WALKERS_RSTRIDE","stride for reading hills files");
+  keys.addFlag("WALKERS_BINARY",false,"exchange hills between walkers through binary files that are read incrementally");
   keys.add("optional","INTERVAL","monodimensional lower and upper limits, outside the limits the system will not feel the biasing force.");
   keys.add("optional","SIGMA_MAX","the upper bounds for the sigmas (in CV units) when using adaptive hills. Negative number means no bounds ");
   keys.add("optional","SIGMA_MIN","the lower bounds for the sigmas (in CV units) when using adaptive hills. Negative number means no bounds ");
-  keys.addFlag("WALKERS_MPI",false,"Switch on MPI version of multiple walkers - not compatible with WALKERS_* options other than WALKERS_DIR");
+  keys.addFlag("WALKERS_MPI",false,"Switch on MPI version of multiple walkers - not compatible with WALKERS_* options other than WALKERS_DIR and WALKERS_RSTRIDE");
   keys.addFlag("ACCELERATION",false,"Set to TRUE if you want to compute the metadynamics acceleration factor.");  
   keys.use("RESTART");
   keys.use("UPDATE_FROM");
@@ -474,10 +548,13 @@ MetaD::~MetaD(){
    if(ifiles[i]->isOpen()) ifiles[i]->close();
    delete ifiles[i];
   }
+  if(walkersBinary_) walkersBinaryOfile_.close();
+  for(unsigned i=0;i<walkersBinaryFiles_.size();++i) if(walkersBinaryFiles_[i]) std::fclose(walkersBinaryFiles_[i]);
 }
 
 MetaD::MetaD(const ActionOptions& ao):
 PLUMED_BIAS_INIT(ao),
+nhills_(0),
 // Grid stuff initialization
 BiasGrid_(NULL), wgridstride_(0), grid_(false),
 // Metadynamics basic parameters
@@ -490,7 +567,9 @@ flexbin(NULL),
 // Multiple walkers initialization
 mw_n_(1), mw_dir_(""), mw_id_(0), mw_rstride_(1),
 walkers_mpi(false), mpi_nw_(0), mpi_mw_(0),
+mpiPendingCount_(0),
 acceleration(false), acc(0.0),
+walkersBinary_(false),
 // Interval initialization
 uppI_(-1), lowI_(-1), doInt_(false),
 isFirstStep(true),
@@ -656,6 +735,8 @@ last_step_warn_grid(0)
   string gridfilename_;
   parse("GRID_WFILE",gridfilename_); 
   parseFlag("STORE_GRIDS",storeOldGrids_);
+  parseFlag("GRID_WBINARY",binaryGrids_);
+  if(binaryGrids_ && storeOldGrids_) error("STORE_GRIDS cannot be used with GRID_WBINARY");
   if(grid_ && gridfilename_.length()>0){
     if(wgridstride_==0 ) error("frequency with which to output grid not specified use GRID_WSTRIDE");
   }
@@ -691,6 +772,8 @@ last_step_warn_grid(0)
   if(mw_n_<=mw_id_) error("walker ID should be a numerical value less than the total number of walkers");
   parse("WALKERS_DIR",mw_dir_);
   parse("WALKERS_RSTRIDE",mw_rstride_);
+  parseFlag("WALKERS_BINARY",walkersBinary_);
+  if(walkersBinary_ && mw_n_<=1) error("WALKERS_BINARY can only be used with WALKERS_N");
 
   // MPI version
   parseFlag("WALKERS_MPI",walkers_mpi);
@@ -739,14 +822,17 @@ last_step_warn_grid(0)
     if(spline){log.printf("  Grid uses spline interpolation\n");}
     if(sparsegrid){log.printf("  Grid uses sparse grid\n");}
     if(wgridstride_>0){log.printf("  Grid is written on file %s with stride %d\n",gridfilename_.c_str(),wgridstride_);} 
+    if(wgridstride_>0 && binaryGrids_){log.printf("  Grid is written in binary format\n");}
   }
 
   if(mw_n_>1){
     if(walkers_mpi) error("MPI version of multiple walkers is not compatible with filesystem version of multiple walkers");
+    if(plumed.getCheckpointRestart()) error("binary checkpoints cannot be used with WALKERS_N, since the hills of the other walkers are read from their files");
     log.printf("  %d multiple walkers active\n",mw_n_);
     log.printf("  walker id %d\n",mw_id_);
     log.printf("  reading stride %d\n",mw_rstride_);
     if(mw_dir_!="")log.printf("  directory with hills files %s\n",mw_dir_.c_str());
+    if(walkersBinary_) log.printf("  hills are exchanged through binary files\n");
   } else {
     if(walkers_mpi) {
       log.printf("  Multiple walkers active using MPI communnication\n"); 
@@ -760,6 +846,7 @@ last_step_warn_grid(0)
       // info abount number of walkers and walker index
       comm.Bcast(mpi_nw_,0);
       comm.Bcast(mpi_mw_,0);
+      if(mw_rstride_>1) log.printf("  hills are exchanged every %d steps\n",mw_rstride_);
     }
   }
 
@@ -779,6 +866,18 @@ last_step_warn_grid(0)
 
   // for performance
   dp_ = new double[getNumberOfArguments()];
+  for(unsigned i=0;i<getNumberOfArguments();i++){
+    periodic_.push_back(getPntrToArgument(i)->isPeriodic());
+    double period=0.0,invperiod=0.0;
+    if(periodic_[i]){
+      double pmin,pmax;
+      getPntrToArgument(i)->getDomain(pmin,pmax);
+      period=pmax-pmin;
+      invperiod=1.0/period;
+    }
+    period_.push_back(period);
+    invPeriod_.push_back(invperiod);
+  }
 
   // initializing and checking grid
   if(grid_){
@@ -855,8 +954,13 @@ last_step_warn_grid(0)
     }
   }
 
+
   // creating vector of ifile* for hills reading 
   // open all files at the beginning and read Gaussians if restarting
+  if(walkersBinary_){
+    walkersBinaryFiles_.assign(mw_n_,NULL);
+    walkersBinaryPending_.resize(mw_n_);
+  }
   for(int i=0;i<mw_n_;++i){
     string fname;
     if(mw_dir_!="") {
@@ -882,9 +986,17 @@ last_step_warn_grid(0)
     ifilesnames.push_back(fname);
     if(ifile->FileExist(fname)){
       ifile->open(fname);
-      if(getRestart()&&!restartedFromGrid){
+      // with a binary checkpoint the bias is restored without reading the hills
+      if(getRestart()&&!restartedFromGrid&&!plumed.getCheckpointRestart()){
         log.printf("  Restarting from %s:",ifilesnames[i].c_str());                  
-        readGaussians(ifiles[i]);                                                    
+        unsigned n=readGaussians(ifiles[i]);                                                    
+        // the binary file of another walker is opened now and all the records it contains are
+        // considered as already read. Records beyond those in the HILLS file (which is not flushed
+        // at every hill) are hills that were lost from it, and are added here
+        if(walkersBinary_ && i!=mw_id_){
+          unsigned nb=readHillRecords(i,n);
+          if(nb>0) log.printf("  Restarting from %s.bin:      %u Gaussians read\n",ifilesnames[i].c_str(),nb);
+        }
       }
       ifiles[i]->reset(false);
       // close only the walker own hills file for later writing
@@ -913,7 +1025,7 @@ last_step_warn_grid(0)
   }
 
   // Calculate the Tiwary-Parrinello reweighting factor if we are restarting from previous hills
-  if(getRestart() && rewf_grid_.size()>0 ) computeReweightingFactor();
+  if(getRestart() && rewf_grid_.size()>0 && !plumed.getCheckpointRestart()) computeReweightingFactor();
 
   // open grid file for writing
   if(wgridstride_>0){
@@ -946,7 +1058,13 @@ last_step_warn_grid(0)
     hillsOfile_.addConstantField("lower_int").printField("lower_int",lowI_);
     hillsOfile_.addConstantField("upper_int").printField("upper_int",uppI_);
   }
-  hillsOfile_.setHeavyFlush();
+  // with binary exchange the HILLS file is not read by the other walkers while running
+  if(!walkersBinary_) hillsOfile_.setHeavyFlush();
+  if(walkersBinary_){
+    walkersBinaryOfile_.link(*this);
+    walkersBinaryOfile_.enforceSuffix("");
+    walkersBinaryOfile_.open(ifilesnames[mw_id_]+".bin");
+  }
   // output periodicities of variables
   for(unsigned i=0;i<getNumberOfArguments();++i) hillsOfile_.setupPrintValue( getPntrToArgument(i) );
 
@@ -987,7 +1105,7 @@ last_step_warn_grid(0)
   log<<"\n";
 }
 
-void MetaD::readGaussians(IFile *ifile)
+unsigned MetaD::readGaussians(IFile *ifile)
 {
   unsigned ncv=getNumberOfArguments();
   vector<double> center(ncv);
@@ -1006,6 +1124,7 @@ void MetaD::readGaussians(IFile *ifile)
     addGaussian(Gaussian(center,sigma,height,multivariate));
   }     
   log.printf("      %d Gaussians read\n",nhills);
+  return nhills;
 }
 
 bool MetaD::readChunkOfGaussians(IFile *ifile, unsigned n)
@@ -1081,11 +1200,110 @@ void MetaD::writeGaussian(const Gaussian& hill, OFile&file)
   file.printField("height",height).printField("biasf",biasf_);
   if(mw_n_>1) file.printField("clock",int(std::time(0)));
   file.printField();
+  if(walkersBinary_) writeHillRecord(hill);
+}
+
+// A record contains the center, the sigmas (room is left for the multivariate case),
+// the height as stored internally and the multivariate flag
+unsigned MetaD::getHillRecordSize()const
+{
+  unsigned ncv=getNumberOfArguments();
+  return ncv+ncv*(ncv+1)/2+2;
+}
+
+void MetaD::packHillRecord(const Gaussian& hill,vector<double>& records)const
+{
+  unsigned ncv=getNumberOfArguments();
+  unsigned size=getHillRecordSize();
+  records.resize(records.size()+size,0.0);
+  double* record=&records[records.size()-size];
+  for(unsigned i=0;i<ncv;++i) record[i]=hill.center[i];
+  for(unsigned i=0;i<hill.sigma.size();++i) record[ncv+i]=hill.sigma[i];
+  record[size-2]=hill.height;
+  record[size-1]=(hill.multivariate?1.0:0.0);
+}
+
+MetaD::Gaussian MetaD::unpackHillRecord(const double* record)const
+{
+  unsigned ncv=getNumberOfArguments();
+  unsigned size=getHillRecordSize();
+  bool multivariate=(record[size-1]!=0.0);
+  vector<double> center(record,record+ncv);
+  vector<double> sigma(record+ncv,record+ncv+(multivariate?ncv*(ncv+1)/2:ncv));
+  return Gaussian(center,sigma,record[size-2],multivariate);
+}
+
+void MetaD::writeHillRecord(const Gaussian& hill)
+{
+  vector<double> record;
+  packHillRecord(hill,record);
+  walkersBinaryOfile_.write(reinterpret_cast<const char*>(&record[0]),record.size()*sizeof(double));
+}
+
+// Reads the records appended to the binary file of a walker since the last call.
+// The first skip records found are not added, since they were already read from the HILLS file.
+unsigned MetaD::readHillRecords(unsigned walker,unsigned skip)
+{
+  const unsigned size=getHillRecordSize();
+  const size_t bytes=size*sizeof(double);
+  vector<double> records;
+// only the first process reads, so that all the processes add the same hills
+  if(comm.Get_rank()==0){
+    FILE*& fp=walkersBinaryFiles_[walker];
+    if(!fp) fp=std::fopen((ifilesnames[walker]+".bin").c_str(),"rb");
+    if(fp){
+      vector<char> & pending=walkersBinaryPending_[walker];
+      char buffer[65536];
+      size_t n;
+      while((n=std::fread(buffer,1,sizeof(buffer),fp))>0) pending.insert(pending.end(),buffer,buffer+n);
+// clear end-of-file, so that records appended later can be read
+      std::clearerr(fp);
+      size_t nrecords=pending.size()/bytes;
+      size_t first=std::min<size_t>(nrecords,skip);
+      records.resize((nrecords-first)*size);
+      if(records.size()>0) std::memcpy(&records[0],&pending[first*bytes],records.size()*sizeof(double));
+      pending.erase(pending.begin(),pending.begin()+nrecords*bytes);
+    }
+  }
+  unsigned n=records.size();
+  comm.Bcast(n,0);
+  records.resize(n);
+  if(n>0) comm.Bcast(records,0);
+  unsigned nhills=n/size;
+  for(unsigned k=0;k<nhills;++k) addGaussian(unpackHillRecord(&records[k*size]));
+  return nhills;
+}
+
+// All the hills deposited by the walkers since the last exchange are sent with a single
+// collective operation. Hills are then written in the same order they would have been
+// written if they were exchanged at every deposition.
+void MetaD::exchangeHillsMPI()
+{
+  const unsigned size=getHillRecordSize();
+  const unsigned n=mpiPendingCount_;
+  vector<double> all(mpi_nw_*mpiPending_.size(),0.0);
+// only root of group can communicate with other walkers
+  if(comm.Get_rank()==0) multi_sim_comm.Allgather(mpiPending_,all);
+// share info with group members
+  comm.Bcast(all,0);
+// hills of this walker were already added at deposition
+  const bool addOwn=!(mw_rstride_>1);
+  for(unsigned k=0;k<n;k++) for(unsigned i=0;i<mpi_nw_;i++){
+    Gaussian newhill=unpackHillRecord(&all[(i*n+k)*size]);
+// notice that if gamma=1 we store directly -F so this scaling is not necessary:
+    newhill.height*=(biasf_>1.0?(biasf_-1.0)/biasf_:1.0);
+    if(addOwn || i!=mpi_mw_) addGaussian(newhill);
+    writeGaussian(newhill,hillsOfile_);
+  }
+  mpiPending_.clear();
+  mpiPendingCount_=0;
 }
 
 void MetaD::addGaussian(const Gaussian& hill)
 {
-  if(!grid_) hills_.push_back(hill);  
+  if(grid_ && rewf_exp1_.size()>0) markReweightingSupport(hill);
+  if(!grid_) storeHill(hill);
+  else if(!hill.multivariate && !doInt_) addSeparableGaussian(hill);
   else {
     unsigned ncv=getNumberOfArguments();
     vector<unsigned> nneighb=getGaussianSupport(hill);
@@ -1121,6 +1339,80 @@ void MetaD::addGaussian(const Gaussian& hill)
   }
 }
 
+// For hills with a diagonal covariance, the gaussian is the product of one-dimensional factors.
+// These factors are computed once for each grid coordinate in the support, and then multiplied
+// on every point of the support. Points are distributed over openmp threads and each of them
+// is written once, so that the update does not need any communication.
+void MetaD::addSeparableGaussian(const Gaussian& hill)
+{
+  const unsigned ncv=getNumberOfArguments();
+  const vector<unsigned> nneighb=getGaussianSupport(hill);
+  const vector<unsigned> nbin=BiasGrid_->getNbin();
+  const vector<bool> isperiodic=BiasGrid_->getIsPeriodic();
+  const vector<unsigned> center=BiasGrid_->getIndices(hill.center);
+
+// same points, in the same order, as Grid::getNeighbors()
+  bool duplicates=false;
+  vector<vector<Grid::index_t> > offset(ncv);
+  vector<vector<double> > dp2(ncv),gauss(ncv),dgauss(ncv);
+  vector<unsigned> ind(ncv,0);
+  vector<double> xx(ncv);
+  Grid::index_t stride=1;
+  for(unsigned i=0;i<ncv;i++){
+    const int n=nbin[i];
+    if(isperiodic[i] && 2*nneighb[i]+1>nbin[i]) duplicates=true;
+    for(unsigned k=0;k<2*nneighb[i]+1;k++){
+      int i0=int(k)-int(nneighb[i])+int(center[i]);
+      if(!isperiodic[i] && (i0<0 || i0>=n)) continue;
+      if( isperiodic[i] && i0<0)  i0=n-(-i0)%n;
+      if( isperiodic[i] && i0>=n) i0%=n;
+      ind[i]=i0;
+      BiasGrid_->getPoint(ind,xx);
+      double dp=difference(i,hill.center[i],xx[i])*hill.invsigma[i];
+      offset[i].push_back(i0*stride);
+      dp2[i].push_back(dp*dp);
+      gauss[i].push_back(exp(-0.5*dp*dp));
+      dgauss[i].push_back(-dp*hill.invsigma[i]);
+    }
+    ind[i]=0;
+    stride*=nbin[i];
+  }
+  Grid::index_t npoints=1;
+  for(unsigned i=0;i<ncv;i++) npoints*=offset[i].size();
+
+// with a sparse grid, or when the support wraps onto itself, points cannot be written concurrently
+  const bool parallel=!duplicates && dynamic_cast<SparseGrid*>(BiasGrid_)==NULL;
+  unsigned nt=OpenMP::getNumThreads();
+  if(!parallel || nt*10>npoints) nt=1;
+
+  #pragma omp parallel num_threads(nt)
+  {
+    vector<double> der(ncv);
+    vector<unsigned> k(ncv);
+    #pragma omp for
+    for(Grid::index_t ipoint=0;ipoint<npoints;ipoint++){
+      Grid::index_t kk=ipoint;
+      for(unsigned i=0;i<ncv;i++){
+        k[i]=kk%offset[i].size();
+        kk/=offset[i].size();
+      }
+      double d2=0.0;
+      for(unsigned i=0;i<ncv;i++) d2+=dp2[i][k[i]];
+      d2*=0.5;
+      double bias=0.0;
+      for(unsigned i=0;i<ncv;i++) der[i]=0.0;
+      if(d2<DP2CUTOFF){
+        bias=hill.height;
+        for(unsigned i=0;i<ncv;i++) bias*=gauss[i][k[i]];
+        for(unsigned i=0;i<ncv;i++) der[i]=bias*dgauss[i][k[i]];
+      }
+      Grid::index_t ineigh=0;
+      for(unsigned i=0;i<ncv;i++) ineigh+=offset[i][k[i]];
+      BiasGrid_->addValueAndDerivatives(ineigh,bias,der);
+    }
+  }
+}
+
 vector<unsigned> MetaD::getGaussianSupport(const Gaussian& hill)
 {
   vector<unsigned> nneigh;
@@ -1179,18 +1471,14 @@ double MetaD::getBiasAndDerivatives(const vector<double>& cv, double* der)
 {
   double bias=0.0;
   if(!grid_){
-    if(hills_.size()>10000 && (getStep()-last_step_warn_grid)>10000){
+    if(nhills_>10000 && (getStep()-last_step_warn_grid)>10000){
       std::string msg;
-      Tools::convert(hills_.size(),msg);
+      Tools::convert(nhills_,msg);
       msg="You have accumulated "+msg+" hills, you should enable GRIDs to avoid serious performance hits";
       warning(msg);
       last_step_warn_grid=getStep();
     }
-    unsigned stride=comm.Get_size();
-    unsigned rank=comm.Get_rank();
-    for(unsigned i=rank;i<hills_.size();i+=stride){
-      bias+=evaluateGaussian(cv,hills_[i],der);
-    }
+    bias=evaluateHills(&cv[0],der);
     comm.Sum(bias);
     if(der) comm.Sum(der,getNumberOfArguments());
    } else {
@@ -1206,6 +1494,168 @@ double MetaD::getBiasAndDerivatives(const vector<double>& cv, double* der)
   return bias;
 }
 
+void MetaD::storeHill(const Gaussian& hill)
+{
+  const unsigned ncv=getNumberOfArguments();
+  const unsigned nsigma=ncv*(ncv+1)/2;
+  const unsigned B=hillBlockSize_;
+  unsigned nb=blockSize_.size();
+  if(nb==0 || blockSize_[nb-1]==B || blockMultivariate_[nb-1]!=hill.multivariate){
+    blockFirst_.push_back(nhills_);
+    blockSize_.push_back(0);
+    blockMultivariate_.push_back(hill.multivariate);
+    hillsCenter_.resize((nb+1)*ncv*B,0.0);
+    hillsInvSigma_.resize((nb+1)*nsigma*B,0.0);
+    hillsHeight_.resize((nb+1)*B,0.0);
+    for(unsigned i=0;i<ncv;i++){
+      blockLower_.push_back(hill.center[i]);
+      blockUpper_.push_back(hill.center[i]);
+      blockMinInvSigma_.push_back(std::numeric_limits<double>::max());
+    }
+    nb++;
+  }
+  const unsigned b=nb-1;
+  const unsigned h=blockSize_[b];
+  for(unsigned i=0;i<ncv;i++){
+    hillsCenter_[(b*ncv+i)*B+h]=hill.center[i];
+    blockLower_[b*ncv+i]=std::min(blockLower_[b*ncv+i],hill.center[i]);
+    blockUpper_[b*ncv+i]=std::max(blockUpper_[b*ncv+i],hill.center[i]);
+  }
+  if(hill.multivariate){
+    for(unsigned k=0;k<nsigma;k++) hillsInvSigma_[(b*nsigma+k)*B+h]=hill.sigma[k];
+// Gershgorin lower bound of the eigenvalues of the inverse covariance
+    double mineig=std::numeric_limits<double>::max();
+    for(unsigned i=0;i<ncv;i++){
+      double diag=0.0,offdiag=0.0;
+      unsigned k=0;
+      for(unsigned l=0;l<ncv;l++) for(unsigned j=l;j<ncv;j++){
+        if(l==i && j==i) diag=hill.sigma[k];
+        else if(l==i || j==i) offdiag+=std::abs(hill.sigma[k]);
+        k++;
+      }
+      mineig=std::min(mineig,diag-offdiag);
+    }
+    for(unsigned i=0;i<ncv;i++) blockMinInvSigma_[b*ncv+i]=std::min(blockMinInvSigma_[b*ncv+i],std::max(mineig,0.0));
+  } else {
+    for(unsigned i=0;i<ncv;i++){
+      hillsInvSigma_[(b*nsigma+i)*B+h]=hill.invsigma[i];
+      blockMinInvSigma_[b*ncv+i]=std::min(blockMinInvSigma_[b*ncv+i],std::abs(hill.invsigma[i]));
+    }
+  }
+  hillsHeight_[b*B+h]=hill.height;
+  blockSize_[b]++;
+  nhills_++;
+}
+
+// This computes the same quantities as evaluateGaussian() for all the hills assigned to this rank,
+// and accumulates them in the same order, so that the result is identical. Blocks of hills that are
+// certainly beyond DP2CUTOFF are skipped.
+double MetaD::evaluateHills(const double* cv,double* der)
+{
+  const unsigned ncv=getNumberOfArguments();
+  const unsigned nsigma=ncv*(ncv+1)/2;
+  const unsigned B=hillBlockSize_;
+  const unsigned stride=comm.Get_size();
+  const unsigned rank=comm.Get_rank();
+  const double* pcv=cv;
+  double tmpcv[1];
+  if(doInt_){
+    plumed_assert(ncv==1);
+    tmpcv[0]=cv[0];
+    if(cv[0]<lowI_) tmpcv[0]=lowI_;
+    if(cv[0]>uppI_) tmpcv[0]=uppI_;
+    pcv=tmpcv;
+  }
+  double bias=0.0;
+  double dp2[hillBlockSize_];
+  vector<double> dp(ncv*B);
+  for(unsigned b=0;b<blockSize_.size();b++){
+    const unsigned n=blockSize_[b];
+    const double* lower=&blockLower_[b*ncv];
+    const double* upper=&blockUpper_[b*ncv];
+    const double* mininv=&blockMinInvSigma_[b*ncv];
+// lower bound of dp2 for all the hills in the block, from the distance between cv and the bounding box
+    double bound=0.0;
+    for(unsigned i=0;i<ncv;i++){
+      const double half=0.5*(upper[i]-lower[i]);
+      double d;
+      if(periodic_[i]){
+        if(2.0*half>=period_[i]) continue;
+        d=std::abs(Tools::pbc((pcv[i]-(lower[i]+half))*invPeriod_[i])*period_[i]);
+      } else d=std::abs(pcv[i]-(lower[i]+half));
+      d-=half;
+      if(d<=0.0) continue;
+// for multivariate hills mininv is a lower bound of the eigenvalues of the inverse covariance
+      if(blockMultivariate_[b]) bound+=d*d*mininv[i];
+      else bound+=(d*mininv[i])*(d*mininv[i]);
+    }
+    if(0.5*bound>DP2CUTOFF*(1.0+1e-10)) continue;
+
+// differences between cv and centers, as in ActionWithArguments::difference()
+    for(unsigned i=0;i<ncv;i++){
+      const double* c=&hillsCenter_[(b*ncv+i)*B];
+      double* d=&dp[i*B];
+      const double x=pcv[i];
+      if(periodic_[i]){
+        const double p=period_[i],ip=invPeriod_[i];
+        for(unsigned h=0;h<n;h++) d[h]=Tools::pbc((x-c[h])*ip)*p;
+      } else {
+        for(unsigned h=0;h<n;h++) d[h]=x-c[h];
+      }
+    }
+    const double* sig=&hillsInvSigma_[b*nsigma*B];
+    if(blockMultivariate_[b]){
+      for(unsigned h=0;h<n;h++){
+        double t=0.0;
+        unsigned k=0;
+        for(unsigned i=0;i<ncv;i++) for(unsigned j=i;j<ncv;j++){
+          if(i==j) t+=dp[i*B+h]*dp[i*B+h]*sig[k*B+h]*0.5;
+          else t+=dp[i*B+h]*dp[j*B+h]*sig[k*B+h];
+          k++;
+        }
+        dp2[h]=t;
+      }
+    } else {
+      for(unsigned h=0;h<n;h++) dp2[h]=0.0;
+      for(unsigned i=0;i<ncv;i++){
+        double* d=&dp[i*B];
+        const double* is=&sig[i*B];
+        for(unsigned h=0;h<n;h++){
+          d[h]*=is[h];
+          dp2[h]+=d[h]*d[h];
+        }
+      }
+      for(unsigned h=0;h<n;h++) dp2[h]*=0.5;
+    }
+
+    const double* height=&hillsHeight_[b*B];
+    for(unsigned h=0;h<n;h++){
+      if(stride>1 && (blockFirst_[b]+h)%stride!=rank) continue;
+      if(dp2[h]>=DP2CUTOFF) continue;
+      const double bb=height[h]*exp(-dp2[h]);
+      bias+=bb;
+      if(!der) continue;
+      if(blockMultivariate_[b]){
+        for(unsigned i=0;i<ncv;i++){
+          double tmp=0.0;
+          for(unsigned j=0;j<ncv;j++){
+            const unsigned k=(i<=j ? i*ncv-i*(i-1)/2+(j-i) : j*ncv-j*(j-1)/2+(i-j));
+            tmp += dp[j*B+h]*sig[k*B+h]*bb;
+          }
+          der[i]-=tmp;
+        }
+      } else {
+        for(unsigned i=0;i<ncv;i++) der[i]+=-bb*dp[i*B+h]*sig[i*B+h];
+      }
+    }
+  }
+
+  if(doInt_ && der){
+    if(cv[0]<lowI_ || cv[0]>uppI_) for(unsigned i=0;i<ncv;++i) der[i]=0;
+  }
+  return bias;
+}
+
 double MetaD::getGaussianNormalization( const Gaussian& hill )
 {
   double norm=1; 
@@ -1364,6 +1814,61 @@ void MetaD::calculate()
   delete [] der;
 }
 
+// The bias (grid or list of hills) and all the quantities accumulated during the run are saved,
+// so that the hills do not need to be read again when restarting from a binary checkpoint.
+void MetaD::writeCheckpoint(std::ostream&o)const{
+  if(grid_) BiasGrid_->writeBinary(o);
+  else {
+    Tools::writeBinary(o,nhills_);
+    Tools::writeBinary(o,hillsCenter_);
+    Tools::writeBinary(o,hillsInvSigma_);
+    Tools::writeBinary(o,hillsHeight_);
+    Tools::writeBinary(o,blockFirst_);
+    Tools::writeBinary(o,blockSize_);
+    Tools::writeBinary(o,vector<char>(blockMultivariate_.begin(),blockMultivariate_.end()));
+    Tools::writeBinary(o,blockLower_);
+    Tools::writeBinary(o,blockUpper_);
+    Tools::writeBinary(o,blockMinInvSigma_);
+  }
+  if(flexbin) flexbin->writeBinary(o);
+  Tools::writeBinary(o,mpiPending_);
+  Tools::writeBinary(o,mpiPendingCount_);
+  Tools::writeBinary(o,acc);
+  Tools::writeBinary(o,isFirstStep);
+  Tools::writeBinary(o,work_);
+  Tools::writeBinary(o,last_step_warn_grid);
+}
+
+void MetaD::readCheckpoint(std::istream&i){
+  if(grid_) BiasGrid_->readBinary(i);
+  else {
+    vector<char> multivariate;
+    Tools::readBinary(i,nhills_);
+    Tools::readBinary(i,hillsCenter_);
+    Tools::readBinary(i,hillsInvSigma_);
+    Tools::readBinary(i,hillsHeight_);
+    Tools::readBinary(i,blockFirst_);
+    Tools::readBinary(i,blockSize_);
+    Tools::readBinary(i,multivariate);
+    blockMultivariate_.assign(multivariate.begin(),multivariate.end());
+    Tools::readBinary(i,blockLower_);
+    Tools::readBinary(i,blockUpper_);
+    Tools::readBinary(i,blockMinInvSigma_);
+  }
+  if(flexbin) flexbin->readBinary(i);
+  Tools::readBinary(i,mpiPending_);
+  Tools::readBinary(i,mpiPendingCount_);
+  Tools::readBinary(i,acc);
+  Tools::readBinary(i,isFirstStep);
+  Tools::readBinary(i,work_);
+  Tools::readBinary(i,last_step_warn_grid);
+  // the cached exponentials are distributed over the processes, they are computed again
+  if(rewf_grid_.size()>0){
+    rewf_exp1_.clear(); rewf_exp2_.clear(); rewf_boxes_.clear();
+    computeReweightingFactor();
+  }
+}
+
 void MetaD::update(){
   vector<double> cv(getNumberOfArguments());
   vector<double> thissigma;
@@ -1397,36 +1902,17 @@ void MetaD::update(){
     // returns normal sigma
     else thissigma=sigma0_;
 
-    // In case we use walkers_mpi, it is now necessary to communicate with other replicas.
+    // In case we use walkers_mpi, the hill is queued and sent to the other replicas.
+    // Hills are added to the local bias as soon as they are deposited only when they are not
+    // sent immediately.
     if(walkers_mpi){
-      // Allocate arrays to store all walkers hills
-      std::vector<double> all_cv(mpi_nw_*cv.size(),0.0);
-      std::vector<double> all_sigma(mpi_nw_*thissigma.size(),0.0);
-      std::vector<double> all_height(mpi_nw_,0.0);
-      std::vector<int>    all_multivariate(mpi_nw_,0);
-      if(comm.Get_rank()==0){
-        // Communicate (only root)
-        multi_sim_comm.Allgather(cv,all_cv);
-        multi_sim_comm.Allgather(thissigma,all_sigma);
-// notice that if gamma=1 we store directly -F so this scaling is not necessary:
-        multi_sim_comm.Allgather(height*(biasf_>1.0?biasf_/(biasf_-1.0):1.0),all_height);
-        multi_sim_comm.Allgather(int(multivariate),all_multivariate);
-      }
-      // Share info with group members
-      comm.Bcast(all_cv,0);
-      comm.Bcast(all_sigma,0);
-      comm.Bcast(all_height,0);
-      comm.Bcast(all_multivariate,0);
-      for(unsigned i=0;i<mpi_nw_;i++){
-        // actually add hills one by one
-        std::vector<double> cv_now(cv.size());
-        std::vector<double> sigma_now(thissigma.size());
-        for(unsigned j=0;j<cv.size();j++) cv_now[j]=all_cv[i*cv.size()+j];
-        for(unsigned j=0;j<thissigma.size();j++) sigma_now[j]=all_sigma[i*thissigma.size()+j];
 // notice that if gamma=1 we store directly -F so this scaling is not necessary:
-        Gaussian newhill=Gaussian(cv_now,sigma_now,all_height[i]*(biasf_>1.0?(biasf_-1.0)/biasf_:1.0),all_multivariate[i]);
+      packHillRecord(Gaussian(cv,thissigma,height*(biasf_>1.0?biasf_/(biasf_-1.0):1.0),multivariate),mpiPending_);
+      mpiPendingCount_++;
+      if(mw_rstride_>1){
+        Gaussian newhill=unpackHillRecord(&mpiPending_[mpiPending_.size()-getHillRecordSize()]);
+        newhill.height*=(biasf_>1.0?(biasf_-1.0)/biasf_:1.0);
         addGaussian(newhill);
-        writeGaussian(newhill,hillsOfile_);
       }
     } else {
       Gaussian newhill=Gaussian(cv,thissigma,height,multivariate);
@@ -1438,8 +1924,12 @@ void MetaD::update(){
 
 // this should be outside of the if block in case
 // mw_rstride_ is not a multiple of stride_
+// all the walkers deposit at the same steps, so that they all have the same number of pending hills
+  if(walkers_mpi && mpiPendingCount_>0 && (getStep()%mw_rstride_==0 || getCPT())) exchangeHillsMPI();
+
   if(mw_n_>1 && getStep()%mw_rstride_==0){
-    hillsOfile_.flush();
+    if(walkersBinary_) walkersBinaryOfile_.flush();
+    else hillsOfile_.flush();
   }
 
   double vbias1=getBiasAndDerivatives(cv);
@@ -1460,7 +1950,8 @@ void MetaD::update(){
       } 
       if(r==0) gridfile_.rewind();
     }
-    BiasGrid_->writeToFile(gridfile_); 
+    if(binaryGrids_) BiasGrid_->writeToBinaryFile(gridfile_);
+    else BiasGrid_->writeToFile(gridfile_); 
     // if a single grid is stored, it is necessary to flush it, otherwise
     // the file might stay empty forever (when a single grid is not large enough to
     // trigger flushing from the operating system).
@@ -1475,6 +1966,12 @@ void MetaD::update(){
     for(int i=0;i<mw_n_;++i){
       // don't read your own Gaussians
       if(i==mw_id_) continue;
+      // binary files are opened once and only the new records are read
+      if(walkersBinary_){
+        unsigned n=readHillRecords(i);
+        if(n>0) log.printf("  Reading hills from %s.bin:      %u Gaussians read\n",ifilesnames[i].c_str(),n);
+        continue;
+      }
       // if the file is not open yet 
       if(!(ifiles[i]->isOpen())){
         // check if it exists now and open it!
@@ -1560,6 +2057,27 @@ bool MetaD::scanOneHill(IFile *ifile,  vector<Value> &tmpvalues, vector<double>
   }
 }
 
+void MetaD::markReweightingSupport(const Gaussian& hill)
+{
+  // a reweighting point sees the grid nodes of the cell that contains it, so the support
+  // of the hill on the bias grid is enlarged by a couple of bins on each side
+  unsigned ncv=getNumberOfArguments();
+  vector<unsigned> nneighb=getGaussianSupport(hill);
+  for(unsigned j=0;j<ncv;++j){
+    double dmin,dmax;
+    Tools::convert( BiasGrid_->getMin()[j], dmin );
+    Tools::convert( BiasGrid_->getMax()[j], dmax );
+    double spacing=( dmax - dmin ) / static_cast<double>( rewf_grid_[j] );
+    double width=std::min( (nneighb[j]+3.0)*BiasGrid_->getDx()[j], dmax-dmin );
+    rewf_boxes_.push_back( static_cast<int>(std::ceil( (hill.center[j]-width-dmin)/spacing )) );
+    rewf_boxes_.push_back( static_cast<int>(std::floor( (hill.center[j]+width-dmin)/spacing )) );
+  }
+  // beyond this point a complete sweep is cheaper
+  if(rewf_boxes_.size()/(2*ncv)>rewf_exp1_.size()*comm.Get_size()){
+    rewf_exp1_.clear(); rewf_exp2_.clear(); rewf_boxes_.clear();
+  }
+}
+
 void MetaD::computeReweightingFactor()
 {
   if( !welltemp_ ) error("cannot compute the c(t) reweighting factors for non well-tempered metadynamics");
@@ -1573,33 +2091,75 @@ void MetaD::computeReweightingFactor()
   // Recover the minimum values for the grid
   unsigned ncv=getNumberOfArguments();
   unsigned ntotgrid=1;
-  std::vector<double> dmin( ncv ),dmax( ncv ), grid_spacing( ncv ), vals( ncv ); 
+  std::vector<double> dmin( ncv ), grid_spacing( ncv );
   for(unsigned j=0;j<ncv;++j){
     Tools::convert( BiasGrid_->getMin()[j], dmin[j] );
-    Tools::convert( BiasGrid_->getMax()[j], dmax[j] );
-    grid_spacing[j] = ( dmax[j] - dmin[j] ) / static_cast<double>( rewf_grid_[j] );
-    if( !getPntrToArgument(j)->isPeriodic() ) dmax[j] += grid_spacing[j]; 
+    double dmax; Tools::convert( BiasGrid_->getMax()[j], dmax );
+    grid_spacing[j] = ( dmax - dmin[j] ) / static_cast<double>( rewf_grid_[j] );
     ntotgrid *= rewf_grid_[j];
   }
-       
-  // Now sum over whole grid
-  reweight_factor=0.0; double* der=new double[ncv]; std::vector<unsigned> t_index( ncv );
-  double sum1=0.0; double sum2=0.0;
+
+  // Points i=rank,rank+stride,... are owned by this rank and stored at slot i/stride.
+  // The exponentials are cached, so that only points whose bias was changed by
+  // the hills added since the previous call are interpolated again.
+  unsigned rank=comm.Get_rank(), stride=comm.Get_size();
+  unsigned nowned=(rank<ntotgrid ? (ntotgrid-rank+stride-1)/stride : 0);
+  std::vector<unsigned> todo;
+  if(rewf_exp1_.size()!=nowned || rewf_exp1_.size()==0){
+    rewf_exp1_.assign(nowned,0.0); rewf_exp2_.assign(nowned,0.0);
+    todo.resize(nowned);
+    for(unsigned k=0;k<nowned;++k) todo[k]=k;
+  } else {
+    std::vector<char> dirty(nowned,0);
+    std::vector<std::vector<unsigned> > range(ncv);
+    std::vector<unsigned> ind(ncv);
+    for(unsigned ibox=0;ibox<rewf_boxes_.size();ibox+=2*ncv){
+      // list the (possibly wrapped) lattice indexes spanned by the box along each CV
+      bool empty=false;
+      for(unsigned j=0;j<ncv;++j){
+        const int n=rewf_grid_[j];
+        int lo=rewf_boxes_[ibox+2*j], hi=rewf_boxes_[ibox+2*j+1];
+        if(hi-lo+1>=n){ lo=0; hi=n-1; }
+        else if(!getPntrToArgument(j)->isPeriodic()){ lo=std::max(lo,0); hi=std::min(hi,n-1); }
+        range[j].clear();
+        for(int k=lo;k<=hi;++k) range[j].push_back(((k%n)+n)%n);
+        if(range[j].empty()) empty=true;
+        ind[j]=0;
+      }
+      if(empty) continue;
+      while(true){
+        unsigned i=0;
+        for(unsigned j=ncv;j>0;--j) i=i*rewf_grid_[j-1]+range[j-1][ind[j-1]];
+        if(i%stride==rank && !dirty[i/stride]){ dirty[i/stride]=1; todo.push_back(i/stride); }
+        unsigned j=0;
+        for(;j<ncv;++j){ if(++ind[j]<range[j].size()) break; ind[j]=0; }
+        if(j==ncv) break;
+      }
+    }
+  }
+  rewf_boxes_.clear();
+
   double afactor = biasf_ / (kbt_*(biasf_-1.0)); double afactor2 = 1.0 / (kbt_*(biasf_-1.0));
-  unsigned rank=comm.Get_rank(), stride=comm.Get_size(); 
-  for(unsigned i=rank;i<ntotgrid;i+=stride){
-    t_index[0]=(i%rewf_grid_[0]);
-    unsigned kk=i;
-    for(unsigned j=1;j<ncv-1;++j){ kk=(kk-t_index[j-1])/rewf_grid_[i-1]; t_index[j]=(kk%rewf_grid_[i]); }
-    if( ncv>=2 ) t_index[ncv-1]=((kk-t_index[ncv-1])/rewf_grid_[ncv-2]);
-     
-    for(unsigned j=0;j<ncv;++j) vals[j]=dmin[j] + t_index[j]*grid_spacing[j]; 
-
-    double currentb=getBiasAndDerivatives(vals,der);
-    sum1 += exp( afactor*currentb );
-    sum2 += exp( afactor2*currentb );
+  unsigned nt=OpenMP::getNumThreads();
+  if(nt*10>todo.size()) nt=1;
+  #pragma omp parallel num_threads(nt)
+  {
+    std::vector<unsigned> t_index( ncv );
+    std::vector<double> vals( ncv );
+    #pragma omp for
+    for(unsigned k=0;k<todo.size();++k){
+      unsigned kk=rank+todo[k]*stride;
+      for(unsigned j=0;j<ncv;++j){ t_index[j]=kk%rewf_grid_[j]; kk/=rewf_grid_[j]; }
+      for(unsigned j=0;j<ncv;++j) vals[j]=dmin[j] + t_index[j]*grid_spacing[j];
+      double currentb=BiasGrid_->getValue(vals);
+      rewf_exp1_[todo[k]] = exp( afactor*currentb );
+      rewf_exp2_[todo[k]] = exp( afactor2*currentb );
+    }
   }
-  delete [] der;
+
+  // Now sum over whole grid
+  double sum1=0.0; double sum2=0.0;
+  for(unsigned k=0;k<nowned;++k){ sum1 += rewf_exp1_[k]; sum2 += rewf_exp2_[k]; }
   comm.Sum( sum1 ); comm.Sum( sum2 );
   reweight_factor = kbt_ * std::log( sum1/sum2 );
   getPntrToComponent("rct")->set(reweight_factor);
@@ -242,6 +242,7 @@ private:
   double  kbt_;
   int     stride_;
   int     wgridstride_;
+  bool    binaryGrids_;
   bool    welltemp_;
   int mw_n_;
   string mw_dir_;
@@ -295,6 +296,7 @@ void PBMetaD::registerKeywords(Keywords& keys){
   keys.add("optional","GRID_RFILES", "read grid for the bias");
   keys.add("optional","GRID_WSTRIDE", "frequency for dumping the grid");
   keys.add("optional","GRID_WFILES", "dump grid for the bias, default names are used if GRID_WSTRIDE is used without GRID_WFILES.");
+  keys.addFlag("GRID_WBINARY",false,"write the grid files in binary format");
   keys.add("optional","GRID_MIN","the lower bounds for the grid");
   keys.add("optional","GRID_MAX","the upper bounds for the grid");
   keys.add("optional","GRID_BIN","the number of bins for the grid");
@@ -452,6 +454,7 @@ isFirstStep(true)
   parse("GRID_WSTRIDE",wgridstride_);
   vector<string> gridfilenames_;
   parseVector("GRID_WFILES",gridfilenames_);
+  parseFlag("GRID_WBINARY",binaryGrids_);
   if (wgridstride_ == 0 && gridfilenames_.size() > 0) {
     error("frequency with which to output grid not specified use GRID_WSTRIDE");
   }
@@ -591,6 +594,7 @@ isFirstStep(true)
     for(unsigned i=0; i<gridfilenames_.size(); ++i) {
      log.printf("  Grid is written on file %s with stride %d\n",gridfilenames_[i].c_str(),wgridstride_);
     }
+    if(binaryGrids_) log.printf("  Grid is written in binary format\n");
    }
    if(gridreadfilenames_.size()>0) {
     for(unsigned i=0; i<gridreadfilenames_.size(); ++i) {
@@ -1099,7 +1103,8 @@ void PBMetaD::update()
      if(r==0) {
        for(unsigned i=0; i<gridfiles_.size(); ++i) {
          gridfiles_[i]->rewind();
-         BiasGrids_[i]->writeToFile(*gridfiles_[i]);
+         if(binaryGrids_) BiasGrids_[i]->writeToBinaryFile(*gridfiles_[i]);
+         else BiasGrids_[i]->writeToFile(*gridfiles_[i]);
          gridfiles_[i]->flush();
        }
      }
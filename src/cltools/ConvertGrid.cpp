@@ -0,0 +1,159 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2017 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#include "CLTool.h"
+#include "CLToolRegister.h"
+#include "tools/Tools.h"
+#include "tools/Grid.h"
+#include "tools/File.h"
+#include "core/Value.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace PLMD {
+namespace cltools{
+
+//+PLUMEDOC TOOLS convert_grid
+/*
+Convert a grid file between the text and the binary format
+
+Grids written by \ref METAD and \ref PBMETAD with GRID_WBINARY are stored in a binary format,
+which is much faster to write and to read back. Binary grids are recognized automatically
+when they are read, so they can be used with GRID_RFILE or \ref EXTERNAL without conversion.
+This tool converts a binary grid into the usual text format, e.g. to plot it, and a text grid
+into the binary format.
+
+\par Examples
+
+The following command writes the binary grid in the file grid.bin in text format
+in the file grid.dat:
+
+\verbatim
+plumed convert_grid --input grid.bin --output grid.dat
+\endverbatim
+
+A text grid is converted into the binary format with:
+
+\verbatim
+plumed convert_grid --input grid.dat --output grid.bin --binary
+\endverbatim
+
+*/
+//+ENDPLUMEDOC
+
+class ConvertGrid:
+public CLTool
+{
+public:
+  static void registerKeywords( Keywords& keys );
+  explicit ConvertGrid(const CLToolOptions& co );
+  int main(FILE* in, FILE*out,Communicator& pc);
+  string description()const{
+    return "convert a grid file between the text and the binary format";
+  }
+};
+
+PLUMED_REGISTER_CLTOOL(ConvertGrid,"convert_grid")
+
+void ConvertGrid::registerKeywords( Keywords& keys ){
+  CLTool::registerKeywords( keys );
+  keys.add("compulsory","--input","the grid file to be converted");
+  keys.add("compulsory","--output","the file on which the converted grid is written");
+  keys.addFlag("--binary",false,"write the grid in binary format. By default it is written in text format");
+  keys.add("compulsory","--fmt","%14.9f","the format used to write the grid in text format");
+}
+
+ConvertGrid::ConvertGrid(const CLToolOptions& co ):
+CLTool(co)
+{
+  inputdata=commandline;
+}
+
+int ConvertGrid::main(FILE* in, FILE*out,Communicator& pc){
+  string input; parse("--input",input);
+  string output; parse("--output",output);
+  string fmt; parse("--fmt",fmt);
+  bool binary; parseFlag("--binary",binary);
+
+  IFile ifile; ifile.open(input);
+  string funcname; vector<string> names,gmin,gmax; vector<bool> periodic; bool hasder=false;
+  if(Grid::isBinaryFile(ifile.getPath())){
+// the header of binary files is made of text lines terminated by "#! END"
+    string line;
+    while(true){
+      ifile.getline(line);
+      vector<string> words=Tools::getWords(line);
+      plumed_massert(words.size()>=2 && words[0]=="#!","wrong header in binary grid file "+input);
+      if(words[1]=="END") break;
+      else if(words[1]=="FUNCTION" && words.size()==3) funcname=words[2];
+      else if(words[1]=="DERIVATIVES" && words.size()==3) hasder=(words[2]=="true");
+      else if(words[1]=="CV" && words.size()==7){
+        names.push_back(words[2]); gmin.push_back(words[3]); gmax.push_back(words[4]);
+        periodic.push_back(words[6]=="true");
+      }
+    }
+  } else {
+// the variables are the fields with a min_ constant, the function is the first other field
+    vector<string> fields; ifile.scanFieldList(fields);
+    for(unsigned i=0;i<fields.size();++i){
+      if(fields[i].compare(0,4,"min_")==0 || fields[i].compare(0,4,"max_")==0) continue;
+      if(fields[i].compare(0,6,"nbins_")==0 || fields[i].compare(0,9,"periodic_")==0) continue;
+      if(ifile.FieldExist("min_"+fields[i])){
+        string mn,mx,pp;
+        ifile.scanField("min_"+fields[i],mn); ifile.scanField("max_"+fields[i],mx); ifile.scanField("periodic_"+fields[i],pp);
+        names.push_back(fields[i]); gmin.push_back(mn); gmax.push_back(mx); periodic.push_back(pp=="true");
+      } else if(fields[i].compare(0,4,"der_")==0) {
+        hasder=true;
+      } else if(funcname.length()==0) {
+        funcname=fields[i];
+      }
+    }
+  }
+  if(names.size()==0 || funcname.length()==0) error("cannot find the variables and the function in grid file "+input);
+
+  vector<Value*> args(names.size());
+  for(unsigned i=0;i<names.size();++i){
+    args[i]=new Value(NULL,names[i],false);
+    if(periodic[i]) args[i]->setDomain(gmin[i],gmax[i]);
+    else args[i]->setNotPeriodic();
+  }
+  Grid* grid=Grid::create(funcname,args,ifile,false,false,hasder);
+  ifile.close();
+
+  OFile ofile; ofile.open(output);
+  if(binary) grid->writeToBinaryFile(ofile);
+  else {
+    grid->setOutputFmt(fmt);
+    grid->writeToFile(ofile);
+  }
+  ofile.close();
+
+  std::fprintf(out,"Grid %s read from %s and written on %s in %s format\n",funcname.c_str(),input.c_str(),output.c_str(),(binary?"binary":"text"));
+  delete grid;
+  for(unsigned i=0;i<args.size();++i) delete args[i];
+  return 0;
+}
+
+} // End of namespace
+}
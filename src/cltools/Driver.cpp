@@ -226,6 +226,8 @@ void Driver<real>::registerKeywords( Keywords& keys ){
   keys.add("optional","--natoms","provides number of atoms - only used if file format does not contain number of atoms");
   keys.add("optional","--debug-forces","output a file containing the forces due to the bias evaluated using numerical derivatives "
                                        "and using the analytical derivatives implemented in plumed");
+  keys.add("optional","--read-checkpoint","restart the actions from a binary checkpoint written with --write-checkpoint");
+  keys.add("optional","--write-checkpoint","write a binary checkpoint of the actions at the end of the trajectory");
   keys.add("hidden","--debug-float","turns on the single precision version (to check float interface)");
   keys.add("hidden","--debug-dd","use a fake domain decomposition");
   keys.add("hidden","--debug-pd","use a fake particle decomposition");
@@ -337,6 +339,10 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc){
   if(dumpforces!="") parseFlag("--dump-full-virial",dumpfullvirial);
   if( debugforces!="" && (debug_dd || debug_pd) ) error("cannot debug forces and domain/particle decomposition at same time");
   if( debugforces!="" && sizeof(real)!=sizeof(double) ) error("cannot debug forces in single precision mode");
+// are we reading or writing checkpoints
+  string readcheckpoint(""), writecheckpoint("");
+  parse("--read-checkpoint",readcheckpoint);
+  parse("--write-checkpoint",writecheckpoint);
 
   string trajectory_fmt;
 
@@ -470,6 +476,7 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc){
   p.cmd("setTimestep",&timestep);
   p.cmd("setPlumedDat",plumedFile.c_str());
   p.cmd("setLog",out);
+  if(readcheckpoint.length()>0) p.cmd("readCheckpoint",readcheckpoint.c_str());
 
   if(multi){
     string n;
@@ -618,6 +625,12 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc){
       checknatoms=natoms;
       p.cmd("setNatoms",&natoms);
       p.cmd("init");
+// continue the step numbering of the run that wrote the checkpoint
+      if(readcheckpoint.length()>0){
+        long int cstep=0;
+        p.cmd("getCheckpointStep",&cstep);
+        step=cstep+stride;
+      }
     }
     if(checknatoms!=natoms){
        std::string stepstr; Tools::convert(step,stepstr);
@@ -915,6 +928,7 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc){
     step+=stride;
   }
   p.cmd("runFinalJobs");
+  if(writecheckpoint.length()>0) p.cmd("writeCheckpoint",writecheckpoint.c_str());
 
   if(fp_forces) fclose(fp_forces);
   if(debugforces.length()>0) fp_dforces.close();
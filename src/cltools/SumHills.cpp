@@ -97,6 +97,14 @@ You can use a --stride keyword to have a dump each bunch of hills you read
 \verbatim
 plumed sum_hills --stride 300 --hills PATHTOMYHILLSFILE   
 \endverbatim
+Each dump only adds the hills read since the previous one.
+
+Hills are not kept in memory: they are read in chunks and added to the grid,
+so that the memory needed only depends on the size of the grid and large hills files
+can be processed. The grid is split over threads, whose number is set with
+the environment variable PLUMED_NUM_THREADS, and the result does not depend on
+the number of threads. When variables are integrated out with --idw, derivatives
+are not stored on the grid and the projection is also done with threads.
  
 You can also have, in case of welltempered metadynamics, only the negative 
 bias instead of the free energy through the keyword --negbias
@@ -66,6 +66,15 @@ The following example instructs plumed to calculate the total coordination numbe
 COORDINATION GROUPA=1-10 GROUPB=20-100 R_0=0.3 NLIST NL_CUTOFF=0.5 NL_STRIDE=100 
 \endverbatim
 
+Alternatively, the neighbour list can be updated automatically. In the following example the list contains
+all the pairs closer than 0.6 nm (NL_CUTOFF plus NL_SKIN) and it is updated only when an atom has moved by more than 0.05 nm
+since the last update. Provided NL_CUTOFF is larger than the cutoff of the switching function, the result is
+identical to the one obtained without neighbour list. This also works when replica exchange is used,
+whatever the exchange stride.
+\verbatim
+COORDINATION GROUPA=1-10 GROUPB=20-100 SWITCH={RATIONAL R_0=0.3 D_MAX=0.5} NLIST NL_CUTOFF=0.5 NL_SKIN=0.1
+\endverbatim
+
 The following is a dummy example which should compute the value 0 because the self interaction
 of atom 1 is skipped. Notice that in plumed 2.0 "self interactions" were not skipped, and the
 same calculation should return 1.
@@ -98,6 +107,7 @@ public:
 // active methods:
   static void registerKeywords( Keywords& keys );
   virtual double pairing(double distance,double&dfunc,unsigned i,unsigned j)const;
+  virtual void pairings(unsigned n,const double*distance2,double*value,double*dfunc,const unsigned*i,const unsigned*j)const;
 };
 
 PLUMED_REGISTER_ACTION(Coordination,"COORDINATION")
@@ -147,6 +157,10 @@ double Coordination::pairing(double distance,double&dfunc,unsigned i,unsigned j)
   return switchingFunction.calculateSqr(distance,dfunc);
 }
 
+void Coordination::pairings(unsigned n,const double*distance2,double*value,double*dfunc,const unsigned*i,const unsigned*j)const{
+  switchingFunction.calculateSqr(distance2,value,dfunc,n);
+}
+
 }
 
 }
@@ -25,6 +25,7 @@
 #include "tools/OpenMP.h"
 
 #include <string>
+#include <algorithm>
 
 using namespace std;
 
@@ -38,6 +39,9 @@ void CoordinationBase::registerKeywords( Keywords& keys ){
   keys.addFlag("NLIST",false,"Use a neighbour list to speed up the calculation");
   keys.add("optional","NL_CUTOFF","The cutoff for the neighbour list");
   keys.add("optional","NL_STRIDE","The frequency with which we are updating the atoms in the neighbour list");
+  keys.add("optional","NL_SKIN","The skin of the neighbour list. The list contains all the pairs closer than NL_CUTOFF+NL_SKIN "
+                                "and is updated only when an atom has moved by more than half the skin since the last update. "
+                                "This can be used instead of NL_STRIDE");
   keys.add("atoms","GROUPA","First list of atoms");
   keys.add("atoms","GROUPB","Second list of atoms (if empty, N*(N-1)/2 pairs in GROUPA are counted)");
 }
@@ -67,23 +71,29 @@ firsttime(true)
 // neighbor list stuff
   bool doneigh=false;
   double nl_cut=0.0;
+  double nl_skin=0.0;
   int nl_st=0;
   parseFlag("NLIST",doneigh);
   if(doneigh){
    parse("NL_CUTOFF",nl_cut);
    if(nl_cut<=0.0) error("NL_CUTOFF should be explicitly specified and positive");
    parse("NL_STRIDE",nl_st);
-   if(nl_st<=0) error("NL_STRIDE should be explicitly specified and positive");
+   parse("NL_SKIN",nl_skin);
+   if(nl_skin<0.0) error("NL_SKIN should be positive");
+   if(nl_skin>0.0){
+     if(nl_st!=0) error("NL_STRIDE and NL_SKIN cannot be used together");
+   } else if(nl_st<=0) error("NL_STRIDE (or NL_SKIN) should be explicitly specified and positive");
   }
   
   addValueWithDerivatives(); setNotPeriodic();
   if(gb_lista.size()>0){
-    if(doneigh)  nl= new NeighborList(ga_lista,gb_lista,dopair,pbc,getPbc(),nl_cut,nl_st);
+    if(doneigh)  nl= new NeighborList(ga_lista,gb_lista,dopair,pbc,getPbc(),nl_cut+nl_skin,nl_st);
     else         nl= new NeighborList(ga_lista,gb_lista,dopair,pbc,getPbc());
   } else {
-    if(doneigh)  nl= new NeighborList(ga_lista,pbc,getPbc(),nl_cut,nl_st);
+    if(doneigh)  nl= new NeighborList(ga_lista,pbc,getPbc(),nl_cut+nl_skin,nl_st);
     else         nl= new NeighborList(ga_lista,pbc,getPbc());
   }
+  if(nl_skin>0.0) nl->setSkin(nl_skin);
   
   requestAtoms(nl->getFullAtomList());
  
@@ -104,10 +114,14 @@ firsttime(true)
   if(dopair) log.printf("  with PAIR option\n");
   if(doneigh){
    log.printf("  using neighbor lists with\n");
-   log.printf("  update every %d steps and cutoff %f\n",nl_st,nl_cut);
+   if(nl_skin>0.0) log.printf("  cutoff %f and skin %f, updated when an atom moves by more than half the skin\n",nl_cut,nl_skin);
+   else log.printf("  update every %d steps and cutoff %f\n",nl_st,nl_cut);
   }
 }
 
+/// Number of pairs whose pairing functions are computed at the same time
+static const unsigned pairBlock=256;
+
 CoordinationBase::~CoordinationBase(){
   delete nl;
 }
@@ -127,6 +141,13 @@ void CoordinationBase::prepare(){
   }
 }
 
+void CoordinationBase::pairings(unsigned n,const double*distance2,double*value,double*dfunc,const unsigned*i,const unsigned*j)const{
+  for(unsigned k=0;k<n;k++){
+    dfunc[k]=0.;
+    value[k]=pairing(distance2[k],dfunc[k],i[k],j[k]);
+  }
+}
+
 // calculator
 void CoordinationBase::calculate()
 {
@@ -138,6 +159,10 @@ void CoordinationBase::calculate()
 
  if(nl->getStride()>0 && invalidateList){
    nl->update(getPositions());
+ } else if(nl->getSkin()>0.0 && nl->isOutdated(getPositions())){
+// with a skin all the atoms are always requested, since their displacements
+// are needed to decide when the list should be updated
+   nl->update(getPositions());
  }
 
  unsigned stride=comm.Get_size();
@@ -157,39 +182,59 @@ const unsigned nn=nl->size();
 if(nt*stride*10>nn) nt=nn/stride/10;
 if(nt==0)nt=1;
 
+// the pairs of this process are split in blocks, and the pairing functions
+// of a block are computed with a single call
+const unsigned nlocal=(rank<nn ? (nn-rank+stride-1)/stride : 0);
+const unsigned nblocks=(nlocal+pairBlock-1)/pairBlock;
+
 #pragma omp parallel num_threads(nt)
 {
  std::vector<Vector> omp_deriv(getPositions().size());
  Tensor omp_virial;
+ std::vector<Vector> distance(pairBlock);
+ std::vector<double> distance2(pairBlock),value(pairBlock),dfunc(pairBlock);
+ std::vector<unsigned> i0(pairBlock),i1(pairBlock);
 
 #pragma omp for reduction(+:ncoord) nowait
- for(unsigned int i=rank;i<nn;i+=stride) {   
- 
-  Vector distance;
-  unsigned i0=nl->getClosePair(i).first;
-  unsigned i1=nl->getClosePair(i).second;
-
-  if(getAbsoluteIndex(i0)==getAbsoluteIndex(i1)) continue;
-
-  if(pbc){
-   distance=pbcDistance(getPosition(i0),getPosition(i1));
-  } else {
-   distance=delta(getPosition(i0),getPosition(i1));
+ for(unsigned b=0;b<nblocks;b++) {
+
+  unsigned npairs=0;
+  const unsigned last=std::min(nlocal,(b+1)*pairBlock);
+  for(unsigned k=b*pairBlock;k<last;k++){
+   const unsigned i=rank+k*stride;
+   const unsigned j0=nl->getClosePair(i).first;
+   const unsigned j1=nl->getClosePair(i).second;
+
+   if(getAbsoluteIndex(j0)==getAbsoluteIndex(j1)) continue;
+
+   if(pbc){
+    distance[npairs]=pbcDistance(getPosition(j0),getPosition(j1));
+   } else {
+    distance[npairs]=delta(getPosition(j0),getPosition(j1));
+   }
+   distance2[npairs]=distance[npairs].modulo2();
+   i0[npairs]=j0;
+   i1[npairs]=j1;
+   npairs++;
   }
-
-  double dfunc=0.;
-  ncoord += pairing(distance.modulo2(), dfunc,i0,i1);
-
-  Vector dd(dfunc*distance);
-  Tensor vv(dd,distance);
-  if(nt>1){
-    omp_deriv[i0]-=dd;
-    omp_deriv[i1]+=dd;
-    omp_virial-=vv;
-  } else {
-    deriv[i0]-=dd;
-    deriv[i1]+=dd;
-    virial-=vv;
+  if(npairs==0) continue;
+
+  pairings(npairs,&distance2[0],&value[0],&dfunc[0],&i0[0],&i1[0]);
+
+  for(unsigned k=0;k<npairs;k++){
+   ncoord += value[k];
+
+   Vector dd(dfunc[k]*distance[k]);
+   Tensor vv(dd,distance[k]);
+   if(nt>1){
+     omp_deriv[i0[k]]-=dd;
+     omp_deriv[i1[k]]+=dd;
+     omp_virial-=vv;
+   } else {
+     deriv[i0[k]]-=dd;
+     deriv[i1[k]]+=dd;
+     virial-=vv;
+   }
   }
 
  }
@@ -43,6 +43,9 @@ public:
   virtual void calculate();
   virtual void prepare();
   virtual double pairing(double distance,double&dfunc,unsigned i,unsigned j)const=0;
+/// Compute the pairing function for n pairs with squared distances distance2 and atoms i and j.
+/// By default pairing() is called on each pair, it can be overridden to compute all of them at the same time
+  virtual void pairings(unsigned n,const double*distance2,double*value,double*dfunc,const unsigned*i,const unsigned*j)const;
   static void registerKeywords( Keywords& keys );
 };
 
@@ -86,6 +86,11 @@ nframes(0)
     log<<"Found TOTAL "<<nframes<< " PDB in the file "<<reference.c_str()<<" \n"; 
     if(nframes==0) error("at least one frame expected");
   } 
+  for(unsigned i=0;i<msdv.size();i++) if(!msdBatch.add(msdv[i])){
+    msdBatch.clear();
+    break;
+  }
+  if(msdBatch.size()>0) log<<"  Distances from all the frames are computed at once\n";
   if(neigh_stride>0 || neigh_size>0){
            if(neigh_size>int(nframes)){
            	log.printf(" List size required ( %d ) is too large: resizing to the maximum number of frames required: %u  \n",neigh_size,nframes);
@@ -130,7 +135,17 @@ void PathMSDBase::calculate(){
   std::vector<Vector> tmp_derivs2(imgVec.size()*nat);
 
 // if imgVec.size() is less than nframes, it means that only some msd will be calculated
-  for(unsigned i=rank;i<imgVec.size();i+=stride){
+  if(msdBatch.size()>0){
+    std::vector<unsigned> frames;
+    for(unsigned i=rank;i<imgVec.size();i+=stride) frames.push_back(imgVec[i].index);
+    std::vector<double> batch_distances;
+    msdBatch.calculate(getPositions(),frames,batch_distances,tmp_derivs,true);
+    unsigned k=0;
+    for(unsigned i=rank;i<imgVec.size();i+=stride,k++){
+      tmp_distances[i]=batch_distances[k];
+      for(unsigned j=0;j<nat;j++) tmp_derivs2[i*nat+j]=tmp_derivs[k*nat+j];
+    }
+  } else for(unsigned i=rank;i<imgVec.size();i+=stride){
 // store temporary local results
     tmp_distances[i]=msdv[imgVec[i].index].calculate(getPositions(),tmp_derivs,true);
     plumed_assert(tmp_derivs.size()==nat);
@@ -63,6 +63,8 @@ class PathMSDBase : public Colvar {
   int neigh_size;
   int neigh_stride;
   std::vector<RMSD> msdv;
+// all the frames, so that they can be computed at once (empty if this is not possible)
+  RMSDBatch msdBatch;
   std::string reference;
   std::vector<Vector> derivs_s;
   std::vector<Vector> derivs_z;
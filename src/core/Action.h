@@ -224,6 +224,15 @@ public:
 /// The set of all Actions in run for the final time in forward order.
   virtual void runFinalJobs(){}
 
+/// Write the state of the Action in a binary checkpoint.
+/// Actions whose state is not fully determined by their input should override this,
+/// together with readCheckpoint(). By default (if not overridden) nothing is written.
+  virtual void writeCheckpoint(std::ostream&)const{}
+
+/// Read the state of the Action written by writeCheckpoint().
+/// This is called after all the Actions have been created, before the first step.
+  virtual void readCheckpoint(std::istream&){}
+
 /// Tell to the Action to flush open files
   void fflush();
 
@@ -49,6 +49,7 @@ pbc(*new(Pbc)),
 lockRequestAtoms(false),
 donotretrieve(false),
 donotforce(false),
+modifiesglobal(false),
 atoms(plumed.getAtoms())
 {
   atoms.add(this);
@@ -70,12 +71,19 @@ void ActionAtomistic::requestAtoms(const vector<AtomNumber> & a){
   charges.resize(nat);
   int n=atoms.positions.size();
   clearDependencies();
-  unique.clear();
+  vector<AtomNumber> newUnique;
+  newUnique.reserve(indexes.size());
   for(unsigned i=0;i<indexes.size();i++){
     if(indexes[i].index()>=n) error("atom out of range");
     if(atoms.isVirtualAtom(indexes[i])) addDependency(atoms.getVirtualAtomsAction(indexes[i]));
 // only real atoms are requested to lower level Atoms class
-    else unique.insert(indexes[i]);
+    else newUnique.push_back(indexes[i]);
+  }
+  Tools::removeDuplicates(newUnique);
+// Atoms caches the list of requested atoms, so it should only be told about real changes
+  if(newUnique!=unique){
+    unique.swap(newUnique);
+    atoms.setUniqueOutdated();
   }
 
 }
@@ -41,7 +41,7 @@ class ActionAtomistic :
   {
 
   std::vector<AtomNumber> indexes;         // the set of needed atoms
-  std::set<AtomNumber>  unique;
+  std::vector<AtomNumber> unique;        // sorted list of the needed real atoms
   std::vector<Vector>   positions;       // positions of the needed atoms
   double                energy;
   Pbc&                  pbc;
@@ -58,6 +58,8 @@ class ActionAtomistic :
   bool                  donotretrieve;
   bool                  donotforce;
 
+  bool                  modifiesglobal;   // positions, forces or box of Atoms are modified
+
 protected:
   Atoms&                atoms;
 
@@ -145,7 +147,10 @@ public:
 /// Make atoms whole, assuming they are in the proper order
   void makeWhole();
 /// Allow calls to modifyGlobalForce()
-  void allowToAccessGlobalForces(){atoms.zeroallforces=true;}
+  void allowToAccessGlobalForces(){atoms.zeroallforces=true; modifiesglobal=true;}
+/// Declare that this action modifies the global positions, forces, virial or box.
+/// Such an action is never calculated or applied at the same time as other actions.
+  void allowToModifyGlobalAtoms(){modifiesglobal=true;}
 public:
 
 // virtual functions:
@@ -168,7 +173,9 @@ public:
   void applyForces();
   void lockRequests();
   void unlockRequests();
-  const std::set<AtomNumber> & getUnique()const;
+  const std::vector<AtomNumber> & getUnique()const;
+/// Check if this action modifies the global positions, forces, virial or box
+  bool modifiesGlobalAtoms()const{return modifiesglobal;}
 /// Read in an input file containing atom positions and calculate the action for the atomic 
 /// configuration therin
   void readAtomsFromPDB( const PDB& pdb );
@@ -266,7 +273,7 @@ void ActionAtomistic::unlockRequests(){
 }
 
 inline
-const std::set<AtomNumber> & ActionAtomistic::getUnique()const{
+const std::vector<AtomNumber> & ActionAtomistic::getUnique()const{
   return unique;
 }
 
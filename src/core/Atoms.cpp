@@ -24,6 +24,7 @@
 #include "MDAtoms.h"
 #include "PlumedMain.h"
 #include "tools/Pbc.h"
+#include "tools/Tools.h"
 #include <algorithm>
 #include <iostream>
 #include <string>
@@ -60,7 +61,9 @@ Atoms::Atoms(PlumedMain&plumed):
   forceOnEnergy(0.0),
   zeroallforces(false),
   kbT(0.0),
+  uniqueOutdated(true),
   asyncSent(false),
+  asyncGatherStarted(false),
   atomsNeeded(false),
   ddStep(0)
 {
@@ -138,7 +141,6 @@ void Atoms::setForces(void*p,int i){
 }
 
 void Atoms::share(){
-  std::set<AtomNumber> unique;
 // At first step I scatter all the atoms so as to store their mass and charge
 // Notice that this works with the assumption that charges and masses are
 // not changing during the simulation!
@@ -146,24 +148,44 @@ void Atoms::share(){
     shareAll();
     return;
   }
-  for(unsigned i=0;i<actions.size();i++) if(actions[i]->isActive()) {
-    if(dd && shuffledAtoms>0){
-      unique.insert(actions[i]->getUnique().begin(),actions[i]->getUnique().end());
+  if(uniqueActive.size()!=actions.size()){
+    uniqueActive.assign(actions.size(),false);
+    uniqueOutdated=true;
+  }
+  for(unsigned i=0;i<actions.size();i++){
+    const bool active=actions[i]->isActive();
+    if(active!=uniqueActive[i]){
+      uniqueActive[i]=active;
+      uniqueOutdated=true;
     }
-    if(!actions[i]->getUnique().empty()) atomsNeeded=true;
+    if(active && !actions[i]->getUnique().empty()) atomsNeeded=true;
+  }
+  if(dd && shuffledAtoms>0){
+// the merged list is only rebuilt when some request or the set of active actions changed
+    if(uniqueOutdated){
+      unique.clear();
+      for(unsigned i=0;i<actions.size();i++) if(uniqueActive[i])
+        unique.insert(unique.end(),actions[i]->getUnique().begin(),actions[i]->getUnique().end());
+      Tools::removeDuplicates(unique);
+      uniqueOutdated=false;
+    }
+    share(unique);
+  } else {
+    share(std::vector<AtomNumber>());
   }
-  share(unique);
 }
 
 void Atoms::shareAll(){
-  std::set<AtomNumber> unique;
-  if(dd && shuffledAtoms>0)
-    for(int i=0;i<natoms;i++) unique.insert(AtomNumber::index(i));
+  std::vector<AtomNumber> all;
+  if(dd && shuffledAtoms>0){
+    all.resize(natoms);
+    for(int i=0;i<natoms;i++) all[i]=AtomNumber::index(i);
+  }
   atomsNeeded=true;
-  share(unique);
+  share(all);
 }
 
-void Atoms::share(const std::set<AtomNumber>& unique){
+void Atoms::share(const std::vector<AtomNumber>& unique){
   plumed_assert( positionsHaveBeenSet==3 && massesHaveBeenSet );
   virial.zero();
   if(zeroallforces || int(gatindex.size())==natoms){
@@ -201,6 +223,11 @@ void Atoms::share(const std::set<AtomNumber>& unique){
       for(unsigned i=0;i<dd.mpi_request_positions.size();i++) dd.mpi_request_positions[i].wait();
       for(unsigned i=0;i<dd.mpi_request_index.size();i++)     dd.mpi_request_index[i].wait();
     }
+// a gather which was not completed by wait() should be completed before reusing the buffers
+    if(asyncGatherStarted){
+      for(unsigned i=0;i<dd.mpi_request_gather.size();i++) dd.mpi_request_gather[i].wait();
+      asyncGatherStarted=false;
+    }
     int count=0;
     for(const auto & p : unique){
       if(dd.g2l[p.index()]>=0){
@@ -225,27 +252,33 @@ void Atoms::share(const std::set<AtomNumber>& unique){
       }
     }else{
       const int n=(dd.Get_size());
-      vector<int> counts(n);
-      vector<int> displ(n);
-      vector<int> counts5(n);
-      vector<int> displ5(n);
-      dd.Allgather(count,counts);
-      displ[0]=0;
-      for(int i=1;i<n;++i) displ[i]=displ[i-1]+counts[i-1];
-      for(int i=0;i<n;++i) counts5[i]=counts[i]*ndata;
-      for(int i=0;i<n;++i) displ5[i]=displ[i]*ndata;
-      dd.Allgatherv(&dd.indexToBeSent[0],count,&dd.indexToBeReceived[0],&counts[0],&displ[0]);
-      dd.Allgatherv(&dd.positionsToBeSent[0],ndata*count,&dd.positionsToBeReceived[0],&counts5[0],&displ5[0]);
-      int tot=displ[n-1]+counts[n-1];
-      for(int i=0;i<tot;i++){
-        positions[dd.indexToBeReceived[i]][0]=dd.positionsToBeReceived[ndata*i+0];
-        positions[dd.indexToBeReceived[i]][1]=dd.positionsToBeReceived[ndata*i+1];
-        positions[dd.indexToBeReceived[i]][2]=dd.positionsToBeReceived[ndata*i+2];
-        if(!massAndChargeOK){
-          masses[dd.indexToBeReceived[i]]      =dd.positionsToBeReceived[ndata*i+3];
-          charges[dd.indexToBeReceived[i]]     =dd.positionsToBeReceived[ndata*i+4];
-        }
-      }
+      dd.counts.resize(n);
+      dd.displ.resize(n);
+      dd.counts5.resize(n);
+      dd.displ5.resize(n);
+      dd.Allgather(count,dd.counts);
+      dd.displ[0]=0;
+      for(int i=1;i<n;++i) dd.displ[i]=dd.displ[i-1]+dd.counts[i-1];
+      for(int i=0;i<n;++i) dd.counts5[i]=dd.counts[i]*ndata;
+      for(int i=0;i<n;++i) dd.displ5[i]=dd.displ[i]*ndata;
+// the gather is only started here and completed in wait(), so that the MD code
+// can do something else in the meanwhile
+      dd.mpi_request_gather.resize(2);
+      dd.mpi_request_gather[0]=dd.Iallgatherv(&dd.indexToBeSent[0],count,&dd.indexToBeReceived[0],&dd.counts[0],&dd.displ[0]);
+      dd.mpi_request_gather[1]=dd.Iallgatherv(&dd.positionsToBeSent[0],ndata*count,&dd.positionsToBeReceived[0],&dd.counts5[0],&dd.displ5[0]);
+      asyncGatherStarted=true;
+    }
+  }
+}
+
+void Atoms::storeReceivedAtoms(int count,int ndata){
+  for(int i=0;i<count;i++){
+    positions[dd.indexToBeReceived[i]][0]=dd.positionsToBeReceived[ndata*i+0];
+    positions[dd.indexToBeReceived[i]][1]=dd.positionsToBeReceived[ndata*i+1];
+    positions[dd.indexToBeReceived[i]][2]=dd.positionsToBeReceived[ndata*i+2];
+    if(!massAndChargeOK){
+      masses[dd.indexToBeReceived[i]]      =dd.positionsToBeReceived[ndata*i+3];
+      charges[dd.indexToBeReceived[i]]     =dd.positionsToBeReceived[ndata*i+4];
     }
   }
 }
@@ -274,17 +307,15 @@ void Atoms::wait(){
         dd.Recv(&dd.positionsToBeReceived[ndata*count],dd.positionsToBeReceived.size()-ndata*count,i,667);
         count+=c;
       }
-      for(int i=0;i<count;i++){
-        positions[dd.indexToBeReceived[i]][0]=dd.positionsToBeReceived[ndata*i+0];
-        positions[dd.indexToBeReceived[i]][1]=dd.positionsToBeReceived[ndata*i+1];
-        positions[dd.indexToBeReceived[i]][2]=dd.positionsToBeReceived[ndata*i+2];
-        if(!massAndChargeOK){
-          masses[dd.indexToBeReceived[i]]      =dd.positionsToBeReceived[ndata*i+3];
-          charges[dd.indexToBeReceived[i]]     =dd.positionsToBeReceived[ndata*i+4];
-        }
-      }
+      storeReceivedAtoms(count,ndata);
       asyncSent=false;
     }
+    if(asyncGatherStarted){
+      for(unsigned i=0;i<dd.mpi_request_gather.size();i++) dd.mpi_request_gather[i].wait();
+      const int n=(dd.Get_size());
+      storeReceivedAtoms(dd.displ[n-1]+dd.counts[n-1],ndata);
+      asyncGatherStarted=false;
+    }
     if(collectEnergy) dd.Sum(energy);
   }
 // I take note that masses and charges have been set once for all
@@ -318,12 +349,14 @@ void Atoms::setNatoms(int n){
 
 void Atoms::add(const ActionAtomistic*a){
   actions.push_back(a);
+  uniqueOutdated=true;
 }
 
 void Atoms::remove(const ActionAtomistic*a){
   auto f=find(actions.begin(),actions.end(),a);
   plumed_massert(f!=actions.end(),"cannot remove an action registered to atoms");
   actions.erase(f);
+  uniqueOutdated=true;
 }
 
 
@@ -101,7 +101,17 @@ class Atoms
   std::vector<const ActionAtomistic*> actions;
   std::vector<int>    gatindex;
 
+/// Sorted list of the atoms requested by the active actions.
+/// It is only rebuilt when the requests or the set of active actions change
+  std::vector<AtomNumber> unique;
+/// Activity of the actions when unique was built
+  std::vector<bool> uniqueActive;
+/// Set when some action changed its request
+  bool uniqueOutdated;
+
   bool asyncSent;
+/// Set when the non-blocking gather started in share() should be completed in wait()
+  bool asyncGatherStarted;
   bool atomsNeeded;
 
   class DomainDecomposition:
@@ -114,6 +124,13 @@ class Atoms
 
     std::vector<Communicator::Request> mpi_request_positions;
     std::vector<Communicator::Request> mpi_request_index;
+    std::vector<Communicator::Request> mpi_request_gather;
+/// Counts and displacements for the gather.
+/// They are stored here since they should be available until the gather is completed
+    std::vector<int>    counts;
+    std::vector<int>    displ;
+    std::vector<int>    counts5;
+    std::vector<int>    displ5;
     
     std::vector<double> positionsToBeSent;
     std::vector<double> positionsToBeReceived;
@@ -129,7 +146,9 @@ class Atoms
   DomainDecomposition dd;
   long int ddStep;  //last step in which dd happened
 
-  void share(const std::set<AtomNumber>&);
+  void share(const std::vector<AtomNumber>&);
+/// Copy the count atoms received from the other processes to positions (and masses/charges)
+  void storeReceivedAtoms(int count,int ndata);
 
 public:
 
@@ -193,6 +212,8 @@ public:
 
   void add(const ActionAtomistic*);
   void remove(const ActionAtomistic*);
+/// Tell that an action changed the list of requested atoms
+  void setUniqueOutdated(){uniqueOutdated=true;}
 
   double getEnergy()const{plumed_assert(collectEnergy && energyHasBeenSet); return energy;}
 
@@ -350,4 +350,14 @@ vector<double> FlexibleBin::getInverseMatrix(unsigned iarg) const{
 	return uppervec;  
 }
 
+void FlexibleBin::writeBinary(std::ostream&o)const{
+	Tools::writeBinary(o,variance);
+	Tools::writeBinary(o,average);
+}
+
+void FlexibleBin::readBinary(std::istream&i){
+	Tools::readBinary(i,variance);
+	Tools::readBinary(i,average);
+}
+
 }
@@ -23,6 +23,7 @@
 #define __PLUMED_core_FlexibleBin_h
 
 #include<vector>
+#include<iosfwd>
 
 namespace PLMD{
 
@@ -54,6 +55,10 @@ class FlexibleBin{
 		std::vector<double> getMatrix() const;
 		std::vector<double> getInverseMatrix() const;
 		std::vector<double> getInverseMatrix(unsigned iarg) const;
+		/// write the running averages in a binary checkpoint
+		void writeBinary(std::ostream&)const;
+		/// read the running averages written by writeBinary()
+		void readBinary(std::istream&);
 		enum AdaptiveHillsType { none, diffusion, geometry }; 
 };
 
@@ -24,6 +24,7 @@
 #include "ActionPilot.h"
 #include "ActionRegister.h"
 #include "ActionSet.h"
+#include "ActionWithArguments.h"
 #include "ActionWithValue.h"
 #include "ActionWithVirtualAtom.h"
 #include "Atoms.h"
@@ -36,12 +37,15 @@
 #include "tools/DLLoader.h"
 #include "tools/Exception.h"
 #include "tools/IFile.h"
+#include "tools/OFile.h"
 #include "tools/Log.h"
 #include "tools/OpenMP.h"
 #include "tools/Tools.h"
 #include "tools/Stopwatch.h"
+#include "tools/Profiler.h"
 #include <cstdlib>
 #include <cstring>
+#include <exception>
 #include <set>
 #include <unordered_map>
 
@@ -81,10 +85,13 @@ PlumedMain::PlumedMain():
   exchangeStep(false),
   restart(false),
   doCheckPoint(false),
+  checkpointStep(0),
   stopFlag(NULL),
   stopNow(false),
   novirial(false),
-  detailedTimers(false)
+  detailedTimers(false),
+  profiler(NULL),
+  parallelActions(false)
 {
   log.link(comm);
   log.setLinePrefix("PLUMED: ");
@@ -275,7 +282,7 @@ void PlumedMain::cmd(const std::string & word,void*val){
         break;
       case cmd_getApiVersion:
         CHECK_NOTNULL(val,word);
-        *(static_cast<int*>(val))=4;
+        *(static_cast<int*>(val))=5;
         break;
       // commands which can be used only before initialization:
       case cmd_init:
@@ -376,6 +383,23 @@ void PlumedMain::cmd(const std::string & word,void*val){
         doCheckPoint = false;
         if(*static_cast<int*>(val)!=0) doCheckPoint = true;
         break;
+      /* ADDED WITH API==5 */
+      case cmd_readCheckpoint:
+        CHECK_NOTINIT(initialized,word);
+        CHECK_NOTNULL(val,word);
+        checkpointFile=static_cast<char*>(val);
+        restart=true;
+        break;
+      case cmd_writeCheckpoint:
+        CHECK_INIT(initialized,word);
+        CHECK_NOTNULL(val,word);
+        writeCheckpoint(static_cast<char*>(val));
+        break;
+      case cmd_getCheckpointStep:
+        CHECK_INIT(initialized,word);
+        CHECK_NOTNULL(val,word);
+        *static_cast<long int*>(val)=checkpointStep;
+        break;
       /* STOP API */
       case cmd_setMDEngine:
         CHECK_NOTINIT(initialized,word);
@@ -490,6 +514,7 @@ void PlumedMain::init(){
     readInputFile(plumedDat);
     plumedDat="";
   }
+  if(checkpointFile.length()>0) readCheckpoint(checkpointFile);
   atoms.updateUnits();
   log.printf("Timestep: %f\n",atoms.getTimeStep());
   if(atoms.getKbT()>0.0)
@@ -504,6 +529,83 @@ void PlumedMain::init(){
   log<<"Finished setup\n";
 }
 
+// The checkpoint contains a header followed by the label and the binary state of each action,
+// so that the input file can be checked to be consistent with the one used to write it.
+static const std::string checkpointMagic="PLUMED_CHECKPOINT";
+static const unsigned checkpointVersion=1;
+
+void PlumedMain::writeCheckpoint(const std::string&path){
+  std::ostringstream o;
+  Tools::writeBinary(o,checkpointMagic);
+  Tools::writeBinary(o,checkpointVersion);
+  Tools::writeBinary(o,step);
+  Tools::writeBinary(o,work);
+  Tools::writeBinary(o,static_cast<unsigned>(actionSet.size()));
+  for(const auto & p : actionSet){
+    std::ostringstream a;
+    p->writeCheckpoint(a);
+    Tools::writeBinary(o,p->getLabel());
+    Tools::writeBinary(o,a.str());
+  }
+  const std::string buffer=o.str();
+  OFile ofile;
+  ofile.link(*this);
+// a checkpoint is a single snapshot, so it is never appended even when restarting
+  ofile.enforceBackup();
+  ofile.open(path);
+  ofile.write(buffer.c_str(),buffer.size());
+  ofile.close();
+  log.printf("Checkpoint of step %ld written on %s\n",step,path.c_str());
+}
+
+void PlumedMain::readCheckpoint(const std::string&path){
+// the file is read by the first process and broadcasted
+  IFile ifile;
+  ifile.link(*this);
+  plumed_massert(ifile.FileExist(path),"cannot find checkpoint file "+path);
+  std::vector<char> buffer;
+  unsigned long size=0;
+  if(comm.Get_rank()==0){
+    FILE* fp=std::fopen(ifile.getPath().c_str(),"rb");
+    plumed_massert(fp,"cannot open checkpoint file "+ifile.getPath());
+    char chunk[65536];
+    size_t n;
+    while((n=std::fread(chunk,1,sizeof(chunk),fp))>0) buffer.insert(buffer.end(),chunk,chunk+n);
+    std::fclose(fp);
+    size=buffer.size();
+  }
+  comm.Bcast(size,0);
+  buffer.resize(size);
+  if(size>0) comm.Bcast(buffer,0);
+
+  std::istringstream i(std::string(buffer.begin(),buffer.end()));
+  std::string magic;
+  unsigned version=0;
+  long int cstep=0;
+  unsigned nactions=0;
+  Tools::readBinary(i,magic);
+  plumed_massert(i && magic==checkpointMagic,"file "+path+" is not a PLUMED checkpoint");
+  Tools::readBinary(i,version);
+  plumed_massert(i && version==checkpointVersion,"checkpoint "+path+" was written with an incompatible version of PLUMED");
+  Tools::readBinary(i,cstep);
+  Tools::readBinary(i,work);
+  Tools::readBinary(i,nactions);
+  plumed_massert(i,"checkpoint "+path+" is truncated");
+  plumed_massert(nactions==actionSet.size(),"checkpoint "+path+" was written with a different number of actions");
+  for(const auto & p : actionSet){
+    std::string label,state;
+    Tools::readBinary(i,label);
+    Tools::readBinary(i,state);
+    plumed_massert(i,"checkpoint "+path+" is truncated");
+    plumed_massert(label==p->getLabel(),"checkpoint "+path+" contains action "+label+" in place of "+p->getLabel());
+    std::istringstream a(state);
+    p->readCheckpoint(a);
+    plumed_massert(a && a.tellg()==std::streampos(state.size()),"checkpoint data of action "+label+" are not consistent with its input");
+  }
+  checkpointStep=cstep;
+  log.printf("Restarting from checkpoint of step %ld read from %s\n",cstep,path.c_str());
+}
+
 void PlumedMain::readInputFile(std::string str){
   plumed_assert(initialized);
   log.printf("FILE: %s\n",str.c_str());
@@ -585,6 +687,10 @@ void PlumedMain::prepareCalc(){
 void PlumedMain::prepareDependencies(){
 
   stopwatch.start("1 Prepare dependencies");
+  if(profiler){
+    profiler->setPhase("prepare");
+    profiler->start("prepare");
+  }
 
 // activate all the actions which are on step
 // activation is recursive and enables also the dependencies
@@ -615,6 +721,7 @@ void PlumedMain::prepareDependencies(){
     }
   }
 
+  if(profiler) profiler->stop("prepare");
   stopwatch.stop("1 Prepare dependencies");
 }
 
@@ -622,7 +729,12 @@ void PlumedMain::shareData(){
 // atom positions are shared (but only if there is something to do)
   if(!active)return;
   stopwatch.start("2 Sharing data");
+  if(profiler){
+    profiler->setPhase("share");
+    profiler->start("share");
+  }
   if(atoms.getNatoms()>0) atoms.share();
+  if(profiler) profiler->stop("share");
   stopwatch.stop("2 Sharing data");
 }
 
@@ -642,51 +754,138 @@ void PlumedMain::performCalc(){
 void PlumedMain::waitData(){
   if(!active)return;
   stopwatch.start("3 Waiting for data");
+  if(profiler){
+    profiler->setPhase("wait");
+    profiler->start("wait");
+  }
   if(atoms.getNatoms()>0) atoms.wait();
+  if(profiler) profiler->stop("wait");
   stopwatch.stop("3 Waiting for data");
 }
 
+/// Actions that only depend on atoms can be calculated and applied at the same time.
+/// Virtual atoms and actions modifying global positions or forces (e.g. FIT_TO_TEMPLATE)
+/// are excluded since they write on the shared Atoms object.
+static bool isIndependentAction(Action*p){
+  ActionAtomistic*aa=dynamic_cast<ActionAtomistic*>(p);
+  return aa && !aa->modifiesGlobalAtoms() && dynamic_cast<ActionWithValue*>(p)
+      && !dynamic_cast<ActionWithArguments*>(p) && !dynamic_cast<ActionWithVirtualAtom*>(p);
+}
+
+/// Check if action p depends on one of the actions in the list
+static bool dependsOnAny(const Action*p,const std::vector<std::pair<Action*,int> >&list){
+  for(const auto & d : p->getDependencies()) for(const auto & q : list) if(d==q.first) return true;
+  return false;
+}
+
+/// Check if one of the actions in the list depends on action p
+static bool isDependencyOfAny(Action*p,const std::vector<std::pair<Action*,int> >&list){
+  for(const auto & q : list) for(const auto & d : q.first->getDependencies()) if(d==p) return true;
+  return false;
+}
+
 void PlumedMain::justCalculate(){
   if(!active)return;
   stopwatch.start("4 Calculating (forward loop)");
+  if(profiler){
+    profiler->setPhase("calculate");
+    profiler->start("calculate");
+  }
   bias=0.0;
   work=0.0;
 
+// consecutive independent actions are collected and calculated at the same time
+  std::vector<std::pair<Action*,int> > independent;
   int iaction=0;
 // calculate the active actions in order (assuming *backward* dependence)
   for(const auto & p : actionSet){
     if(p->isActive()){
-      std::string actionNumberLabel;
-      if(detailedTimers){
-        Tools::convert(iaction,actionNumberLabel);
-        actionNumberLabel="4A "+actionNumberLabel+" "+p->getLabel();
-        stopwatch.start(actionNumberLabel);
-      }
-      ActionWithValue*av=dynamic_cast<ActionWithValue*>(p);
-      ActionAtomistic*aa=dynamic_cast<ActionAtomistic*>(p);
-      {
-        if(av) av->clearInputForces();
-        if(av) av->clearDerivatives();
-      }
-      {
-        if(aa) aa->clearOutputForces();
-        if(aa) if(aa->isActive()) aa->retrieveAtoms();
+      if(parallelActions && isIndependentAction(p)){
+        if(dependsOnAny(p,independent)) calculateActionsInParallel(independent);
+        independent.push_back(std::pair<Action*,int>(p,iaction));
+      } else {
+        calculateActionsInParallel(independent);
+        calculateAction(p,iaction);
+        ActionWithValue*av=dynamic_cast<ActionWithValue*>(p);
+        // This retrieves components called bias 
+        if(av) bias+=av->getOutputQuantity("bias");
+        if(av) work+=av->getOutputQuantity("work");
       }
-      if(p->checkNumericalDerivatives()) p->calculateNumericalDerivatives();
-      else p->calculate();
-      // This retrieves components called bias 
-      if(av) bias+=av->getOutputQuantity("bias");
-      if(av) work+=av->getOutputQuantity("work");
-      if(av)av->setGradientsIfNeeded();	
-      ActionWithVirtualAtom*avv=dynamic_cast<ActionWithVirtualAtom*>(p);
-      if(avv)avv->setGradientsIfNeeded();	
-      if(detailedTimers) stopwatch.stop(actionNumberLabel);
     }
     iaction++;
   }
+  calculateActionsInParallel(independent);
+  if(profiler) profiler->stop("calculate");
   stopwatch.stop("4 Calculating (forward loop)");
 }
 
+void PlumedMain::calculateAction(Action*p,int iaction){
+  std::string actionNumberLabel;
+  if(detailedTimers){
+    Tools::convert(iaction,actionNumberLabel);
+    actionNumberLabel="4A "+actionNumberLabel+" "+p->getLabel();
+#pragma omp critical(plumedMainStopwatch)
+    stopwatch.start(actionNumberLabel);
+  }
+  std::string profilerPath;
+  if(profiler){
+    profilerPath="calculate/"+p->getLabel();
+    profiler->start(profilerPath);
+  }
+  ActionWithValue*av=dynamic_cast<ActionWithValue*>(p);
+  ActionAtomistic*aa=dynamic_cast<ActionAtomistic*>(p);
+  {
+    if(av) av->clearInputForces();
+    if(av) av->clearDerivatives();
+  }
+  {
+    if(aa) aa->clearOutputForces();
+    if(aa) if(aa->isActive()) aa->retrieveAtoms();
+  }
+  if(p->checkNumericalDerivatives()) p->calculateNumericalDerivatives();
+  else p->calculate();
+  if(av)av->setGradientsIfNeeded();	
+  ActionWithVirtualAtom*avv=dynamic_cast<ActionWithVirtualAtom*>(p);
+  if(avv)avv->setGradientsIfNeeded();	
+  if(profiler) profiler->stop(profilerPath);
+  if(detailedTimers){
+#pragma omp critical(plumedMainStopwatch)
+    stopwatch.stop(actionNumberLabel);
+  }
+}
+
+/// Rethrow the first stored exception, if any
+static void rethrowFirst(const std::vector<std::exception_ptr>&errors){
+  for(const auto & e : errors) if(e) std::rethrow_exception(e);
+}
+
+void PlumedMain::calculateActionsInParallel(std::vector<std::pair<Action*,int> >&independent){
+  const unsigned n=independent.size();
+  if(n==0) return;
+  unsigned nt=OpenMP::getNumThreads();
+  if(nt>n) nt=n;
+  if(nt==0) nt=1;
+// exceptions cannot leave a parallel region, so they are stored and the first one
+// (in input order) is rethrown after the loop, as it would happen in the serial loop
+  std::vector<std::exception_ptr> errors(n);
+#pragma omp parallel for schedule(dynamic,1) num_threads(nt)
+  for(unsigned i=0;i<n;i++){
+    try{
+      calculateAction(independent[i].first,independent[i].second);
+    } catch(...){
+      errors[i]=std::current_exception();
+    }
+  }
+  rethrowFirst(errors);
+// bias and work are accumulated in input order so that the result does not depend on threads
+  for(unsigned i=0;i<n;i++){
+    ActionWithValue*av=dynamic_cast<ActionWithValue*>(independent[i].first);
+    bias+=av->getOutputQuantity("bias");
+    work+=av->getOutputQuantity("work");
+  }
+  independent.clear();
+}
+
 void PlumedMain::justApply(){
   backwardPropagate();
   update();
@@ -696,44 +895,114 @@ void PlumedMain::backwardPropagate(){
   if(!active)return;
   int iaction=0;
   stopwatch.start("5 Applying (backward loop)");
+  if(profiler){
+    profiler->setPhase("apply");
+    profiler->start("apply");
+  }
+// consecutive independent actions are collected and applied at the same time
+  std::vector<std::pair<Action*,int> > independent;
 // apply them in reverse order
   for(auto pp=actionSet.rbegin();pp!=actionSet.rend();++pp){
     const auto & p(*pp);
     if(p->isActive()){
-
-      std::string actionNumberLabel;
-      if(detailedTimers){
-        Tools::convert(iaction,actionNumberLabel);
-        actionNumberLabel="5A "+actionNumberLabel+" "+p->getLabel();
-        stopwatch.start(actionNumberLabel);
+      if(parallelActions && isIndependentAction(p)){
+        if(isDependencyOfAny(p,independent)) applyActionsInParallel(independent);
+        independent.push_back(std::pair<Action*,int>(p,iaction));
+      } else {
+        applyActionsInParallel(independent);
+        applyAction(p,iaction);
       }
-
-      p->apply();
-      ActionAtomistic*a=dynamic_cast<ActionAtomistic*>(p);
-// still ActionAtomistic has a special treatment, since they may need to add forces on atoms
-      if(a) a->applyForces();
-
-      if(detailedTimers) stopwatch.stop(actionNumberLabel);
     }
     iaction++;
   }
+  applyActionsInParallel(independent);
 
 // this is updating the MD copy of the forces
   if(detailedTimers) stopwatch.start("5B Update forces");
   if(atoms.getNatoms()>0) atoms.updateForces();
   if(detailedTimers) stopwatch.stop("5B Update forces");
+  if(profiler) profiler->stop("apply");
   stopwatch.stop("5 Applying (backward loop)");
 }
 
+void PlumedMain::applyAction(Action*p,int iaction){
+  std::string actionNumberLabel;
+  if(detailedTimers){
+    Tools::convert(iaction,actionNumberLabel);
+    actionNumberLabel="5A "+actionNumberLabel+" "+p->getLabel();
+    stopwatch.start(actionNumberLabel);
+  }
+  std::string profilerPath;
+  if(profiler){
+    profilerPath="apply/"+p->getLabel();
+    profiler->start(profilerPath);
+  }
+
+  p->apply();
+  ActionAtomistic*a=dynamic_cast<ActionAtomistic*>(p);
+// still ActionAtomistic has a special treatment, since they may need to add forces on atoms
+  if(a) a->applyForces();
+
+  if(profiler) profiler->stop(profilerPath);
+  if(detailedTimers) stopwatch.stop(actionNumberLabel);
+}
+
+void PlumedMain::applyActionsInParallel(std::vector<std::pair<Action*,int> >&independent){
+  const unsigned n=independent.size();
+  if(n==0) return;
+  unsigned nt=OpenMP::getNumThreads();
+  if(nt>n) nt=n;
+  if(nt==0) nt=1;
+// see calculateActionsInParallel() for exceptions
+  std::vector<std::exception_ptr> errors(n);
+#pragma omp parallel for schedule(dynamic,1) num_threads(nt)
+  for(unsigned i=0;i<n;i++) try{
+    std::string actionNumberLabel;
+    if(detailedTimers){
+      Tools::convert(independent[i].second,actionNumberLabel);
+      actionNumberLabel="5A "+actionNumberLabel+" "+independent[i].first->getLabel();
+#pragma omp critical(plumedMainStopwatch)
+      stopwatch.start(actionNumberLabel);
+    }
+    std::string profilerPath;
+    if(profiler){
+      profilerPath="apply/"+independent[i].first->getLabel();
+      profiler->start(profilerPath);
+    }
+    independent[i].first->apply();
+    if(profiler) profiler->stop(profilerPath);
+    if(detailedTimers){
+#pragma omp critical(plumedMainStopwatch)
+      stopwatch.stop(actionNumberLabel);
+    }
+  } catch(...){
+    errors[i]=std::current_exception();
+  }
+  rethrowFirst(errors);
+// forces are added to the shared array in the same order as in the serial loop
+  for(unsigned i=0;i<n;i++) dynamic_cast<ActionAtomistic*>(independent[i].first)->applyForces();
+  independent.clear();
+}
+
 void PlumedMain::update(){
   if(!active)return;
 
   stopwatch.start("6 Update");
+  if(profiler){
+    profiler->setPhase("update");
+    profiler->start("update");
+  }
 // update step (for statistics, etc)
   updateFlags.push(true);
   for(const auto & p : actionSet){
     p->beforeUpdate();
-    if(p->isActive() && p->checkUpdate() && updateFlagsTop()) p->update();
+    if(p->isActive() && p->checkUpdate() && updateFlagsTop()){
+      if(profiler){
+        profiler->start("update/"+p->getLabel());
+        p->update();
+        profiler->stop("update/"+p->getLabel());
+      } else p->update();
+    }
   }
   while(!updateFlags.empty()) updateFlags.pop();
   if(!updateFlags.empty()) plumed_merror("non matching changes in the update flags");
@@ -751,6 +1020,7 @@ void PlumedMain::update(){
     log.flush();
     for(const auto & p : actionSet) p->fflush();
   }
+  if(profiler) profiler->stop("update");
   stopwatch.stop("6 Update");
 }
 
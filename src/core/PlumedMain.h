@@ -50,6 +50,7 @@ namespace PLMD {
 
 
 
+class Action;
 class ActionAtomistic;
 class ActionPilot;
 class Log;
@@ -58,6 +59,7 @@ class ActionSet;
 class DLLoader;
 class Communicator;
 class Stopwatch;
+class Profiler;
 class Citations;
 class ExchangePatterns;
 class FileBase;
@@ -136,6 +138,11 @@ private:
 /// Flag for checkpointig
   bool doCheckPoint;
 
+/// Binary checkpoint to be read at initialization
+  std::string checkpointFile;
+/// Step at which the checkpoint read at initialization was written
+  long int checkpointStep;
+
   std::set<FileBase*> files;
 
 /// Stuff to make plumed stop the MD code cleanly
@@ -146,6 +153,15 @@ private:
 /// Store information used in class \ref generic::UpdateIf
   std::stack<bool> updateFlags;
 
+/// Forward loop on a single action
+  void calculateAction(Action*,int iaction);
+/// Backward loop on a single action
+  void applyAction(Action*,int iaction);
+/// Forward loop on a set of independent actions, done at the same time with openmp
+  void calculateActionsInParallel(std::vector<std::pair<Action*,int> >&);
+/// Backward loop on a set of independent actions, done at the same time with openmp
+  void applyActionsInParallel(std::vector<std::pair<Action*,int> >&);
+
 public:
 /// Flag to switch off virial calculation (for debug and MD codes with no barostat)
   bool novirial;
@@ -153,6 +169,13 @@ public:
 /// Flag to switch on detailed timers
   bool detailedTimers;
 
+/// Profiler recording the time spent in each phase and action, NULL if profiling is off.
+/// It is owned by the PROFILE action
+  Profiler* profiler;
+
+/// Flag to calculate and apply independent actions at the same time
+  bool parallelActions;
+
 /// Add a citation, returning a string containing the reference number, something like "[10]"
   std::string cite(const std::string&);
 
@@ -308,6 +331,13 @@ public:
   void setRestart(bool f){restart=f;}
 /// Check if checkpointing 
   bool getCPT()const;
+/// Check if the state of the actions is going to be read from a binary checkpoint.
+/// In this case actions do not need to reconstruct it from their output files.
+  bool getCheckpointRestart()const{return checkpointFile.length()>0;}
+/// Write the state of all the actions in a binary checkpoint
+  void writeCheckpoint(const std::string&path);
+/// Read the state of all the actions from a binary checkpoint
+  void readCheckpoint(const std::string&path);
 /// Set exchangeStep flag
   void setExchangeStep(bool f);
 /// Get exchangeStep flag
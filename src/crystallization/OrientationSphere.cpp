@@ -67,7 +67,7 @@ MultiColvarBase(ao)
 }
 
 double OrientationSphere::compute( const unsigned& tindex, multicolvar::AtomValuePack& myatoms ) const {
-   double d2, sw, value=0, denom=0, dfunc; Vector ddistance;
+   double sw, value=0, denom=0, dfunc; Vector ddistance;
    unsigned ncomponents=getBaseMultiColvar(0)->getNumberOfQuantities();
    std::vector<double> catom_orient( ncomponents ), this_orient( ncomponents );
    std::vector<double> this_der( ncomponents ), catom_der( ncomponents ); 
@@ -75,13 +75,26 @@ double OrientationSphere::compute( const unsigned& tindex, multicolvar::AtomValu
    getInputData( 0, true, myatoms, catom_orient ); 
    MultiValue& myder0=getInputDerivatives( 0, true, myatoms ); 
 
-   for(unsigned i=1;i<myatoms.getNumberOfAtoms();++i){
-      Vector& distance=myatoms.getPosition(i);  
-      if ( (d2=distance[0]*distance[0])<rcut2 &&
-           (d2+=distance[1]*distance[1])<rcut2 &&
-           (d2+=distance[2]*distance[2])<rcut2) {
- 
-         sw = switchingFunction.calculateSqr( d2, dfunc );  
+   // The neighbors within the cutoff are collected in chunks and their switching
+   // functions are computed with a single call
+   const unsigned chunk=64;
+   double d2[chunk], swk[chunk], dfunck[chunk]; unsigned index[chunk];
+   unsigned n=0;
+   const unsigned natoms=myatoms.getNumberOfAtoms();
+   for(unsigned j=1;j<natoms;++j){
+      Vector& dist=myatoms.getPosition(j);
+      double dd;
+      if ( (dd=dist[0]*dist[0])<rcut2 &&
+           (dd+=dist[1]*dist[1])<rcut2 &&
+           (dd+=dist[2]*dist[2])<rcut2) {
+         d2[n]=dd; index[n]=j; n++;
+      }
+      if( n<chunk && !(j+1==natoms && n>0) ) continue;
+      switchingFunction.calculateSqr( d2, swk, dfunck, n );
+      for(unsigned k=0;k<n;++k){
+         const unsigned i=index[k];
+         Vector& distance=myatoms.getPosition(i);
+         sw = swk[k]; dfunc = dfunck[k];
  
          getInputData( i, true, myatoms, this_orient );
          // Calculate the dot product wrt to this position 
@@ -105,6 +118,7 @@ double OrientationSphere::compute( const unsigned& tindex, multicolvar::AtomValu
          value += sw*f_dot;
          denom += sw;
       }
+      n=0;
    }
    double rdenom, df2, pref=calculateCoordinationPrefactor( denom, df2 );
    if( fabs(denom)>epsilon ){ rdenom = 1.0 / denom; }
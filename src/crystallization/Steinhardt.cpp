@@ -74,16 +74,30 @@ void Steinhardt::calculateVector( multicolvar::AtomValuePack& myatoms ) const {
   std::complex<double> ii( 0.0, 1.0 ), dp_x, dp_y, dp_z;
 
   unsigned ncomp=2*tmom+1; 
-  double sw, poly_ass, d2, dlen; std::complex<double> powered;
-  for(unsigned i=1;i<myatoms.getNumberOfAtoms();++i){
-      Vector& distance=myatoms.getPosition(i);  // getSeparation( myatoms.getPosition(0), myatoms.getPosition(i) );
-      if ( (d2=distance[0]*distance[0])<rcut2 &&
-           (d2+=distance[1]*distance[1])<rcut2 &&
-           (d2+=distance[2]*distance[2])<rcut2) {
-         dlen = sqrt(d2);
-         sw = switchingFunction.calculate( dlen, dfunc ); 
+  double sw, poly_ass, dlen; std::complex<double> powered;
+  // The neighbors within the cutoff are collected in chunks and their switching
+  // functions are computed with a single call
+  const unsigned chunk=64;
+  double d2[chunk], swk[chunk], dfunck[chunk]; unsigned index[chunk];
+  unsigned n=0;
+  const unsigned natoms=myatoms.getNumberOfAtoms();
+  for(unsigned j=1;j<natoms;++j){
+      Vector& dist=myatoms.getPosition(j);
+      double dd;
+      if ( (dd=dist[0]*dist[0])<rcut2 &&
+           (dd+=dist[1]*dist[1])<rcut2 &&
+           (dd+=dist[2]*dist[2])<rcut2) {
+         d2[n]=dd; index[n]=j; n++;
+      }
+      if( n<chunk && !(j+1==natoms && n>0) ) continue;
+      switchingFunction.calculateSqr( d2, swk, dfunck, n );
+      for(unsigned k=0;k<n;++k){
+         const unsigned i=index[k];
+         Vector& distance=myatoms.getPosition(i);
+         sw = swk[k]; dfunc = dfunck[k];
+         dlen = sqrt(d2[k]);
          accumulateSymmetryFunction( -1, i, sw, (+dfunc)*distance, (-dfunc)*Tensor( distance,distance ), myatoms );  
-         double dlen3 = d2*dlen;
+         double dlen3 = d2[k]*dlen;
          // Do stuff for m=0
          poly_ass=deriv_poly( 0, distance[2]/dlen, dpoly_ass );
          // Derivatives of z/r wrt x, y, z
@@ -135,7 +149,8 @@ void Steinhardt::calculateVector( multicolvar::AtomValuePack& myatoms ) const {
              // Imaginary part
              accumulateSymmetryFunction( 2+ncomp+tmom-m, i, -pref*sw*itq6, -pref*myimagvec, pref*Tensor( myimagvec,distance ), myatoms );    
          }
-     }
+      }
+      n=0;
   } 
 
   // Normalize 
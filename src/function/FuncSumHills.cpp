@@ -461,7 +461,8 @@ historep(NULL)
     // check if the files exists 
     if(integratehills){
          checkFilesAreExisting(hillsFiles); 
-         biasrep=new BiasRepresentation(tmphillsvalues,comm, gmin, gmax, gbin, doInt, lowI_, uppI_);
+         // derivatives are not needed when the bias is projected
+         biasrep=new BiasRepresentation(tmphillsvalues,comm, gmin, gmax, gbin, doInt, lowI_, uppI_, proj.size()==0);
 	 if(negativebias){
 		biasrep->setRescaledToBias(true);
 	        log<<"  required the -bias instead of the free energy \n";
@@ -526,8 +527,7 @@ historep(NULL)
 
     	      		log<<"  Bias: Projecting on subgrid... \n";
               		BiasWeight Bw(beta); 
-             		Grid biasGrid=*(biasrep->getGridPtr());
-   	      		Grid smallGrid=biasGrid.project(proj,&Bw);
+   	      		Grid smallGrid=biasrep->getGridPtr()->project(proj,&Bw);
               		OFile gridfile; gridfile.link(*this);
 	      		std::ostringstream ostr;ostr<<nfiles;
               		string myout; 
@@ -567,7 +567,12 @@ historep(NULL)
 
 		if(integratehills){
 
-	                Grid biasGrid=*(biasrep->getGridPtr());
+			// the grid is copied only if it has to be shifted, otherwise it is
+			// changed in sign and restored after writing, which is exact
+			Grid* biasGridPtr=biasrep->getGridPtr();
+			Grid* shiftedGrid=NULL;
+			if(minTOzero){shiftedGrid=new Grid(*biasGridPtr); biasGridPtr=shiftedGrid;}
+	                Grid& biasGrid=*biasGridPtr;
 			biasGrid.scaleAllValuesAndDerivatives(-1.);
 	
 	                OFile gridfile; gridfile.link(*this);
@@ -582,6 +587,8 @@ historep(NULL)
 	                biasGrid.writeToFile(gridfile);
 	                gridfile.close();
 			// rescale back prior to accumulate
+			if(shiftedGrid) delete shiftedGrid;
+			else biasGrid.scaleAllValuesAndDerivatives(-1.);
                         if(!ibias)integratehills=false;// once you get to the final bunch just give up 
 		}
 		if(integratehisto){
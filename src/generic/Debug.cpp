@@ -23,6 +23,7 @@
 #include "core/ActionPilot.h"
 #include "core/ActionSet.h"
 #include "core/PlumedMain.h"
+#include "tools/Communicator.h"
 
 using namespace std;
 
@@ -44,6 +45,22 @@ DEBUG DETAILED_TIMERS
 DEBUG logRequestedAtoms STRIDE=2
 \endverbatim
 
+If PLUMED runs on a single process and PLUMED_NUM_THREADS is larger than one,
+actions that only depend on atoms (e.g. many \ref TORSION, \ref DISTANCE or \ref RMSD variables)
+can be calculated at the same time on different threads. Functions, biases and virtual atoms are
+still calculated in the order of the input file, and bias and forces are accumulated in the same order
+as in a serial calculation, so that results do not depend on the number of threads.
+\verbatim
+DEBUG PARALLEL_ACTIONS
+\endverbatim
+
+Notice that PARALLEL_ACTIONS is ignored (and a message is written in the log) whenever
+PLUMED runs on more than one MPI process, since actions communicate with collective
+calls that cannot be issued from different threads. This is the case for instance
+of GROMACS runs with domain decomposition, or of multiple walkers and replica exchange simulations
+where each replica uses more than one process.
+It is also ignored when MPI has not been initialized with MPI_THREAD_MULTIPLE.
+
 */
 //+ENDPLUMEDOC
 class Debug:
@@ -54,6 +71,7 @@ class Debug:
   bool logRequestedAtoms;
   bool novirial;
   bool detailedTimers;
+  bool parallelActions;
 public:
   explicit Debug(const ActionOptions&ao);
 /// Register all the relevant keywords for the action  
@@ -72,6 +90,9 @@ void Debug::registerKeywords( Keywords& keys ){
   keys.addFlag("logRequestedAtoms",false,"write in the log which atoms have been requested at a given time");
   keys.addFlag("NOVIRIAL",false,"switch off the virial contribution for the entirity of the simulation");
   keys.addFlag("DETAILED_TIMERS",false,"switch on detailed timers");
+  keys.addFlag("PARALLEL_ACTIONS",false,"calculate and apply actions that only depend on atoms at the same time using openmp threads. "
+                "It is ignored when PLUMED runs on more than one MPI process (e.g. GROMACS with domain decomposition) "
+                "or when MPI was not initialized with MPI_THREAD_MULTIPLE");
   keys.add("optional","FILE","the name of the file on which to output these quantities");
 }
 
@@ -80,7 +101,8 @@ Action(ao),
 ActionPilot(ao),
 logActivity(false),
 logRequestedAtoms(false),
-novirial(false){
+novirial(false),
+parallelActions(false){
   parseFlag("logActivity",logActivity);
   if(logActivity) log.printf("  logging activity\n");
   parseFlag("logRequestedAtoms",logRequestedAtoms);
@@ -90,7 +112,17 @@ novirial(false){
   if(novirial) plumed.novirial=true;
   parseFlag("DETAILED_TIMERS",detailedTimers);
   if(detailedTimers) log.printf("  Detailed timing on\n");
-  plumed.detailedTimers=true;
+  if(detailedTimers) plumed.detailedTimers=true;
+  parseFlag("PARALLEL_ACTIONS",parallelActions);
+  if(parallelActions){
+// collective communications cannot be safely done from different threads
+    if(comm.Get_size()>1) log.printf("  PARALLEL_ACTIONS is ignored when running with more than one process\n");
+    else if(!Communicator::threadMultiple()) log.printf("  PARALLEL_ACTIONS is ignored since MPI was not initialized with MPI_THREAD_MULTIPLE\n");
+    else {
+      log.printf("  Calculating independent actions in parallel\n");
+      plumed.parallelActions=true;
+    }
+  }
   ofile.link(*this);
   std::string file;
   parse("FILE",file);
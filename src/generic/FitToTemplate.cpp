@@ -188,6 +188,7 @@ rmsd(NULL)
   // this is required so as to allow modifyGlobalForce() to return correct
   // also for forces that are not owned (and thus not zeored) by all processors.
   allowToAccessGlobalForces();
+  allowToModifyGlobalAtoms();
 }
 
 
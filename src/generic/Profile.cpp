@@ -0,0 +1,175 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2012-2017 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#include "core/ActionRegister.h"
+#include "core/ActionPilot.h"
+#include "core/PlumedMain.h"
+#include "tools/Profiler.h"
+#include "tools/OFile.h"
+#include <sstream>
+#include <algorithm>
+
+namespace PLMD{
+namespace generic{
+
+using namespace std;
+
+//+PLUMEDOC GENERIC PROFILE
+/*
+Record the time spent in each phase of the calculation and in each action and write it on a file.
+
+Times are recorded separately for each phase of the step (prepare, share, wait,
+calculate, apply and update), for each action within the calculate, apply and update phases
+and, for actions that loop over tasks (e.g. multicolvars), for each stage of the loop.
+For every timer the number of calls, the total, average, minimum and maximum time and
+the 50th, 90th and 99th percentiles of the time of a single call are written.
+Percentiles are estimated from a histogram and have a relative accuracy of about 5%.
+Times are in seconds.
+
+The profile is written on FILE every STRIDE steps and at the end of the simulation. Every time
+the file is overwritten with the statistics accumulated since the beginning of the simulation.
+If the name of the file ends with .csv, the profile is written as comma separated values, with
+one line per timer and the path of the timer (e.g. calculate/d1) in the second column.
+Otherwise, it is written in JSON format, with the timers of the actions nested in the timers of the phases.
+
+With COUNTERS, the listed hardware counters are also recorded using the linux perf_event interface.
+The available counters are cycles, instructions, cache-references, cache-misses, branch-instructions and branch-misses.
+Counters only measure the thread that calls PLUMED, so that actions that are calculated by other threads
+(see PARALLEL_ACTIONS in \ref DEBUG) are timed but not counted; the number of calls where the counters were read is reported
+as counted_calls. If the counters cannot be opened, e.g. because of the settings in /proc/sys/kernel/perf_event_paranoid,
+a warning is written in the log and only times are recorded.
+
+When running with MPI, only the timers of the first process are written.
+Profiling has a small overhead for each action and it is thus not recommended for production runs.
+Notice that \ref DEBUG DETAILED_TIMERS remains available and writes similar information in the log
+at the end of the simulation.
+
+\par Examples
+
+The following input writes the profile of the calculation of two distances
+and of a coordination number every 1000 steps on the file profile.json, including
+the number of cpu cycles and of cache misses:
+\verbatim
+PROFILE FILE=profile.json STRIDE=1000 COUNTERS=cycles,cache-misses
+d1: DISTANCE ATOMS=1,2
+d2: DISTANCE ATOMS=3,4
+c: COORDINATIONNUMBER SPECIES=1-100 SWITCH={RATIONAL R_0=0.5} MEAN
+PRINT ARG=d1,d2,c.mean FILE=colvar
+\endverbatim
+(see also \ref DISTANCE, \ref COORDINATIONNUMBER and \ref PRINT).
+
+*/
+//+ENDPLUMEDOC
+
+class Profile:
+  public ActionPilot
+{
+  Profiler* profiler;
+  OFile ofile;
+  bool csv;
+/// The file has already been written once
+  bool written;
+/// The profile at the end of the simulation has been written
+  bool finalWritten;
+/// Write the accumulated profile, replacing the previous one
+  void writeProfile();
+public:
+  explicit Profile(const ActionOptions&ao);
+  ~Profile();
+  static void registerKeywords( Keywords& keys );
+  void calculate(){}
+  void apply(){}
+  void update();
+  void runFinalJobs();
+};
+
+PLUMED_REGISTER_ACTION(Profile,"PROFILE")
+
+void Profile::registerKeywords( Keywords& keys ){
+  Action::registerKeywords( keys );
+  ActionPilot::registerKeywords( keys );
+  keys.add("compulsory","STRIDE","0","the frequency with which the profile is written. With 0 it is only written at the end of the simulation");
+  keys.add("compulsory","FILE","profile.json","the file on which the profile is written. Files ending with .csv are written as comma separated values, other files in JSON format");
+  keys.add("optional","COUNTERS","comma separated list of hardware counters to be recorded");
+  keys.remove("LABEL");
+}
+
+Profile::Profile(const ActionOptions&ao):
+  Action(ao),
+  ActionPilot(ao),
+  profiler(NULL),
+  csv(false),
+  written(false),
+  finalWritten(false)
+{
+  if(plumed.profiler) error("PROFILE can only be used once");
+  string file; parse("FILE",file);
+  csv=(file.length()>=4 && file.substr(file.length()-4)==".csv");
+  vector<string> counters; parseVector("COUNTERS",counters);
+  checkRead();
+  const vector<string> available=Profiler::getAvailableCounters();
+  for(const auto & c : counters) if(available.size()>0 && find(available.begin(),available.end(),c)==available.end())
+    error("unknown hardware counter "+c);
+
+  profiler=new Profiler(counters);
+  log.printf("  writing profile on file %s in %s format\n",file.c_str(),csv?"CSV":"JSON");
+  if(counters.size()>0){
+    if(profiler->getCounterError().length()>0) log.printf("  WARNING: %s, only times will be recorded\n",profiler->getCounterError().c_str());
+    else {
+      log.printf("  recording hardware counters:");
+      for(const auto & c : counters) log.printf(" %s",c.c_str());
+      log.printf("\n");
+    }
+  }
+// the file is a snapshot of the whole run, so it is not appended on restart
+  ofile.link(*this);
+  ofile.enforceBackup();
+  ofile.open(file);
+  plumed.profiler=profiler;
+}
+
+Profile::~Profile(){
+  if(!finalWritten) writeProfile();
+  plumed.profiler=NULL;
+  delete profiler;
+}
+
+void Profile::writeProfile(){
+  std::ostringstream os;
+  if(csv) profiler->writeCSV(os,getStep());
+  else profiler->writeJSON(os,getStep());
+  if(written) ofile.rewind();
+  ofile.printf("%s",os.str().c_str());
+  ofile.flush();
+  written=true;
+}
+
+void Profile::update(){
+  writeProfile();
+}
+
+void Profile::runFinalJobs(){
+  writeProfile();
+  finalWritten=true;
+}
+
+}
+}
@@ -121,6 +121,7 @@ ActionAtomistic(ao)
   } else error("undefined type "+type);
 
   checkRead();
+  allowToModifyGlobalAtoms();
 }
 
 
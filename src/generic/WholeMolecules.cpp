@@ -176,6 +176,7 @@ ActionAtomistic(ao)
   requestAtoms(merge);
   doNotRetrieve();
   doNotForce();
+  allowToModifyGlobalAtoms();
 }
 
 void WholeMolecules::calculate(){
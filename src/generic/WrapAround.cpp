@@ -209,6 +209,7 @@ groupby(1)
   requestAtoms(merged);
   doNotRetrieve();
   doNotForce();
+  allowToModifyGlobalAtoms();
 }
 
 void WrapAround::calculate(){
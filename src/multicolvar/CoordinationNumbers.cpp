@@ -122,15 +122,27 @@ MultiColvarBase(ao)
 
 double CoordinationNumbers::compute( const unsigned& tindex, AtomValuePack& myatoms ) const {
    // Calculate the coordination number
-   double dfunc, d2, sw;
-   for(unsigned i=1;i<myatoms.getNumberOfAtoms();++i){
+   // The neighbors within the cutoff are collected in chunks and their switching
+   // functions are computed with a single call
+   const unsigned chunk=64;
+   double d2[chunk], sw[chunk], dfunc[chunk]; unsigned index[chunk];
+   unsigned n=0;
+   const unsigned natoms=myatoms.getNumberOfAtoms();
+   for(unsigned i=1;i<natoms;++i){
       Vector& distance=myatoms.getPosition(i);  
-      if ( (d2=distance[0]*distance[0])<rcut2 && 
-           (d2+=distance[1]*distance[1])<rcut2 &&
-           (d2+=distance[2]*distance[2])<rcut2) {
-  
-         sw = switchingFunction.calculateSqr( d2, dfunc );
-         accumulateSymmetryFunction( 1, i, sw, (dfunc)*distance, (-dfunc)*Tensor(distance,distance), myatoms );  
+      double dd;
+      if ( (dd=distance[0]*distance[0])<rcut2 && 
+           (dd+=distance[1]*distance[1])<rcut2 &&
+           (dd+=distance[2]*distance[2])<rcut2) {
+         d2[n]=dd; index[n]=i; n++;
+      }
+      if( n==chunk || (i+1==natoms && n>0) ){
+         switchingFunction.calculateSqr( d2, sw, dfunc, n );
+         for(unsigned k=0;k<n;++k){
+            Vector& dist=myatoms.getPosition(index[k]);
+            accumulateSymmetryFunction( 1, index[k], sw[k], (dfunc[k])*dist, (-dfunc[k])*Tensor(dist,dist), myatoms );
+         }
+         n=0;
       }
    }
 
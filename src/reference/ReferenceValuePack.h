@@ -23,6 +23,8 @@
 #define __PLUMED_reference_ReferenceValuePack_h
 
 #include "tools/MultiValue.h"
+#include "tools/Tensor.h"
+#include "tools/Matrix.h"
 
 namespace PLMD {
 
@@ -22,14 +22,18 @@
 #include "BiasRepresentation.h"
 #include "core/Value.h"
 #include "Communicator.h"
+#include "OpenMP.h"
 #include <iostream>
 
 namespace PLMD {
 
 using namespace std;
 
+/// number of kernels that are read before adding them to the grid
+static const unsigned kernelChunk=1024;
+
 /// the constructor here
-BiasRepresentation::BiasRepresentation(const vector<Value*> & tmpvalues, Communicator &cc ):hasgrid(false),rescaledToBias(false),mycomm(cc),BiasGrid_(NULL){
+BiasRepresentation::BiasRepresentation(const vector<Value*> & tmpvalues, Communicator &cc ):hasgrid(false),rescaledToBias(false),nkernels(0),mycomm(cc),BiasGrid_(NULL){
     lowI_=0.0;
     uppI_=0.0;
     doInt_=false;
@@ -38,9 +42,10 @@ BiasRepresentation::BiasRepresentation(const vector<Value*> & tmpvalues, Communi
          values.push_back(tmpvalues[i]);
          names.push_back(values[i]->getName());
     } 
+    clear();
 }
 /// overload the constructor: add the sigma  at constructor time 
-BiasRepresentation::BiasRepresentation(const vector<Value*> & tmpvalues, Communicator &cc,  const vector<double> & sigma ):hasgrid(false), rescaledToBias(false), histosigma(sigma),mycomm(cc),BiasGrid_(NULL){
+BiasRepresentation::BiasRepresentation(const vector<Value*> & tmpvalues, Communicator &cc,  const vector<double> & sigma ):hasgrid(false), rescaledToBias(false), nkernels(0), histosigma(sigma),mycomm(cc),BiasGrid_(NULL){
     lowI_=0.0;
     uppI_=0.0;
     doInt_=false;
@@ -49,10 +54,11 @@ BiasRepresentation::BiasRepresentation(const vector<Value*> & tmpvalues, Communi
          values.push_back(tmpvalues[i]);
          names.push_back(values[i]->getName());
     } 
+    clear();
 } 
 /// overload the constructor: add the grid at constructor time 
 BiasRepresentation::BiasRepresentation(const vector<Value*> & tmpvalues, Communicator &cc , const vector<string> & gmin, const vector<string> & gmax, 
-                                       const vector<unsigned> & nbin, bool doInt, double lowI, double uppI ):hasgrid(false), rescaledToBias(false), mycomm(cc), BiasGrid_(NULL){
+                                       const vector<unsigned> & nbin, bool doInt, double lowI, double uppI, bool usederiv ):hasgrid(false), rescaledToBias(false), nkernels(0), mycomm(cc), BiasGrid_(NULL){
     ndim=tmpvalues.size();
     for(int  i=0;i<ndim;i++){
          values.push_back(tmpvalues[i]);
@@ -61,11 +67,12 @@ BiasRepresentation::BiasRepresentation(const vector<Value*> & tmpvalues, Communi
     doInt_=doInt;
     lowI_=lowI;
     uppI_=uppI;
+    clear();
     // initialize the grid 
-    addGrid(gmin,gmax,nbin);
+    addGrid(gmin,gmax,nbin,usederiv);
 } 
 /// overload the constructor with some external sigmas: needed for histogram
-BiasRepresentation::BiasRepresentation(const vector<Value*> & tmpvalues, Communicator &cc , const vector<string> & gmin, const vector<string> & gmax, const vector<unsigned> & nbin , const vector<double> & sigma):hasgrid(false), rescaledToBias(false),histosigma(sigma),mycomm(cc),BiasGrid_(NULL){
+BiasRepresentation::BiasRepresentation(const vector<Value*> & tmpvalues, Communicator &cc , const vector<string> & gmin, const vector<string> & gmax, const vector<unsigned> & nbin , const vector<double> & sigma):hasgrid(false), rescaledToBias(false),nkernels(0),histosigma(sigma),mycomm(cc),BiasGrid_(NULL){
     lowI_=0.0;
     uppI_=0.0;
     doInt_=false;
@@ -74,29 +81,30 @@ BiasRepresentation::BiasRepresentation(const vector<Value*> & tmpvalues, Communi
          values.push_back(tmpvalues[i]);
          names.push_back(values[i]->getName());
     }
+    clear();
     // initialize the grid 
     addGrid(gmin,gmax,nbin);
 }
 
 BiasRepresentation::~BiasRepresentation(){
   if(BiasGrid_) delete BiasGrid_;
-  for(unsigned i=0;i<hills.size();i++) delete hills[i];
+  for(unsigned i=0;i<pending.size();i++) delete pending[i];
 }
 
-void  BiasRepresentation::addGrid( const vector<string> & gmin, const vector<string> & gmax, const vector<unsigned> & nbin ){
-    plumed_massert(hills.size()==0,"you can set the grid before loading the hills");
+void  BiasRepresentation::addGrid( const vector<string> & gmin, const vector<string> & gmax, const vector<unsigned> & nbin, bool usederiv ){
+    plumed_massert(nkernels==0,"you can set the grid before loading the hills");
     plumed_massert(hasgrid==false,"to build the grid you should not having the grid in this bias representation");
     string ss; ss="file.free"; 
     vector<Value*> vv;for(unsigned i=0;i<values.size();i++)vv.push_back(values[i]);
     //cerr<<" initializing grid "<<endl;
-    BiasGrid_=new Grid(ss,vv,gmin,gmax,nbin,false,true);
+    BiasGrid_=new Grid(ss,vv,gmin,gmax,nbin,false,usederiv);
     hasgrid=true;	
 }
 bool BiasRepresentation::hasSigmaInInput(){
    if(histosigma.size()==0){return false;}else{return true;} 
 }
 void BiasRepresentation::setRescaledToBias(bool rescaled){
-	plumed_massert(hills.size()==0,"you can set the rescaling function only before loading hills");
+	plumed_massert(nkernels==0,"you can set the rescaling function only before loading hills");
         rescaledToBias=rescaled;
 }
 const bool & BiasRepresentation::isRescaledToBias(){
@@ -139,7 +147,8 @@ void BiasRepresentation::pushKernel( IFile *ifile ){
 		// and neglect all the rest
  		kk=readFromPoint(ifile)   ;
         }
- 	hills.push_back(kk);		
+	nkernels++;
+	updateMinMax(kk);
 	// the bias factor is not something about the kernels but 
 	// must be stored to keep the  bias/free energy duality
 	string dummy; double dummyd;
@@ -147,7 +156,6 @@ void BiasRepresentation::pushKernel( IFile *ifile ){
 		ifile->scanField("biasf",dummy);
 	        Tools::convert(dummy,dummyd);
 	}else{dummyd=1.0;}
-	biasf.push_back(dummyd);
         // the domain does not pertain to the kernel but to the values here defined 
 	string	mins,maxs,minv,maxv,mini,maxi;mins="min_";maxs="max_";
         for(int i=0 ; i<ndim; i++){
@@ -160,9 +168,65 @@ void BiasRepresentation::pushKernel( IFile *ifile ){
 	      plumed_massert(maxi==maxv,"the input periodicity in hills and in value definition does not match"  ); 	
 	    }
         }
-        // if grid is defined then it should be added on the grid    
- 	//cerr<<"now with "<<hills.size()<<endl;
-        if(hasgrid){
+        // if grid is defined then it should be added on the grid, otherwise it is not needed anymore
+        if(!hasgrid){delete kk; return;}
+	pending.push_back(kk);
+	pendingfactor.push_back(rescaledToBias?(dummyd-1.)/dummyd:1.0);
+	if(pending.size()>=kernelChunk) depositKernels();
+}
+void BiasRepresentation::updateMinMax(const KernelFunctions* kk){
+	int ndiv=10; // adjustable parameter: division per support
+	vector<double> ss;
+	if(histosigma.size()!=0){
+		ss=histosigma;
+	}else{
+		ss=kk->getContinuousSupport();	
+	}
+	vector<double> cc=kk->getCenter();
+	for(int j=0;j<ndim;j++){
+		double dmin=cc[j]-ss[j];
+		double dmax=cc[j]+ss[j];
+		double ddiv=ss[j]/double(ndiv);
+		if(dmin<kmin[j])kmin[j]=dmin; 
+		if(dmax>kmax[j])kmax[j]=dmax; 
+		if(ddiv<kbinsize[j])kbinsize[j]=ddiv;		
+	}
+}
+// Kernels are added in chunks. With a single process, the grid is split in contiguous slabs,
+// one for each thread, and each thread adds all the kernels of the chunk on the points of its slab.
+// Every point thus receives the kernels in the order in which they were read, and the result
+// does not depend on the number of threads.
+void BiasRepresentation::depositKernels(){
+        if(pending.size()==0) return;
+        if(mycomm.Get_size()==1){
+          const Grid::index_t size=BiasGrid_->getSize();
+          unsigned nt=OpenMP::getNumThreads();
+          if(nt>size) nt=1;
+          #pragma omp parallel num_threads(nt)
+          {
+            // values are modified when evaluating the kernels, each thread uses its own copies
+            vector<Value> myvalues(ndim);
+            vector<Value*> vals(ndim);
+            for(int j=0;j<ndim;++j){
+              if(values[j]->isPeriodic()){
+                string mini,maxi; values[j]->getDomain(mini,maxi);
+                myvalues[j].setDomain(mini,maxi);
+              } else myvalues[j].setNotPeriodic();
+              vals[j]=&myvalues[j];
+            }
+            #pragma omp for schedule(static,1)
+            for(unsigned islab=0;islab<nt;islab++){
+              for(unsigned k=0;k<pending.size();k++) depositKernel(pending[k],pendingfactor[k],vals,(size*islab)/nt,(size*(islab+1))/nt);
+            }
+          }
+        } else {
+          for(unsigned k=0;k<pending.size();k++) depositKernel(pending[k],pendingfactor[k],values,0,BiasGrid_->getSize());
+        }
+        for(unsigned k=0;k<pending.size();k++) delete pending[k];
+        pending.clear();
+        pendingfactor.clear();
+}
+void BiasRepresentation::depositKernel(const KernelFunctions* kk, double factor, vector<Value*> & vals, Grid::index_t first, Grid::index_t last){
                  vector<unsigned> nneighb;
                  if(doInt_&&(kk->getCenter()[0]+kk->getContinuousSupport()[0] > uppI_ || kk->getCenter()[0]-kk->getContinuousSupport()[0] < lowI_ )) {
                   nneighb=BiasGrid_->getNbin();
@@ -170,22 +234,24 @@ void BiasRepresentation::pushKernel( IFile *ifile ){
                  vector<Grid::index_t> neighbors=BiasGrid_->getNeighbors(kk->getCenter(),nneighb);
                  vector<double> der(ndim);
                  vector<double> xx(ndim);
+                 const bool usederiv=BiasGrid_->hasDerivatives();
                  if(mycomm.Get_size()==1){
                    for(unsigned i=0;i<neighbors.size();++i){
                      Grid::index_t ineigh=neighbors[i];
+                     if(ineigh<first || ineigh>=last) continue;
                      for(int j=0;j<ndim;++j){der[j]=0.0;}
                      BiasGrid_->getPoint(ineigh,xx);   
                      // assign xx to a new vector of values
-                     for(int j=0;j<ndim;++j){values[j]->set(xx[j]);}
+                     for(int j=0;j<ndim;++j){vals[j]->set(xx[j]);}
                      double bias;	 
-                     if(doInt_) bias=kk->evaluate(values,der,true,doInt_,lowI_,uppI_);
-                     else bias=kk->evaluate(values,der,true);
+                     if(doInt_) bias=kk->evaluate(vals,der,true,doInt_,lowI_,uppI_);
+                     else bias=kk->evaluate(vals,der,true);
 		     if(rescaledToBias){
-			double f=(biasf.back()-1.)/(biasf.back());
-			bias*=f;
-			for(int j=0;j<ndim;++j){der[j]*=f;}
+			bias*=factor;
+			for(int j=0;j<ndim;++j){der[j]*=factor;}
                      }
-                     BiasGrid_->addValueAndDerivatives(ineigh,bias,der);
+                     if(usederiv) BiasGrid_->addValueAndDerivatives(ineigh,bias,der);
+                     else BiasGrid_->addValue(ineigh,bias);
                    } 
                  } else {
                    unsigned stride=mycomm.Get_size();
@@ -196,13 +262,12 @@ void BiasRepresentation::pushKernel( IFile *ifile ){
                    for(unsigned i=rank;i<neighbors.size();i+=stride){
                      Grid::index_t ineigh=neighbors[i];
                      BiasGrid_->getPoint(ineigh,xx);
-                     for(int j=0;j<ndim;++j){values[j]->set(xx[j]);}	 
-                     if(doInt_) allbias[i]=kk->evaluate(values,der,true,doInt_,lowI_,uppI_);
-                     else allbias[i]=kk->evaluate(values,der,true);
+                     for(int j=0;j<ndim;++j){vals[j]->set(xx[j]);}	 
+                     if(doInt_) allbias[i]=kk->evaluate(vals,tmpder,true,doInt_,lowI_,uppI_);
+                     else allbias[i]=kk->evaluate(vals,tmpder,true);
 		     if(rescaledToBias){
-			double f=(biasf.back()-1.)/(biasf.back());
-			allbias[i]*=f;
-			for(int j=0;j<ndim;++j){tmpder[j]*=f;}
+			allbias[i]*=factor;
+			for(int j=0;j<ndim;++j){tmpder[j]*=factor;}
                      }
  	             // this solution with the temporary vector is rather bad, probably better to take 		
 		     // a pointer of double as it was in old gaussian 
@@ -213,41 +278,23 @@ void BiasRepresentation::pushKernel( IFile *ifile ){
                    for(unsigned i=0;i<neighbors.size();++i){
                      Grid::index_t ineigh=neighbors[i];
                      for(int j=0;j<ndim;++j){der[j]=allder[ndim*i+j];}
-                     BiasGrid_->addValueAndDerivatives(ineigh,allbias[i],der);
+                     if(usederiv) BiasGrid_->addValueAndDerivatives(ineigh,allbias[i],der);
+                     else BiasGrid_->addValue(ineigh,allbias[i]);
                    }
                  }
-        }
 }
 int BiasRepresentation::getNumberOfKernels(){
-	return hills.size();
+	return nkernels;
 }
 Grid* BiasRepresentation::getGridPtr(){
         plumed_massert(hasgrid,"if you want the grid pointer then you should have defined a grid before"); 
+        depositKernels();
 	return BiasGrid_;
 }
 void BiasRepresentation::getMinMaxBin(vector<double> &vmin, vector<double> &vmax, vector<unsigned> &vbin){
-	vector<double> ss,cc,binsize; 
-	vmin.clear();vmin.resize(ndim,10.e20);
-	vmax.clear();vmax.resize(ndim,-10.e20);
+	vmin=kmin;
+	vmax=kmax;
 	vbin.clear();vbin.resize(ndim);
-	binsize.clear();binsize.resize(ndim,10.e20);
-	int ndiv=10; // adjustable parameter: division per support
-	for(unsigned i=0;i<hills.size();i++){
-		if(histosigma.size()!=0){
-			ss=histosigma;
-		}else{
-			ss=hills[i]->getContinuousSupport();	
-		}
-		cc=hills[i]->getCenter();
-		for(int j=0;j<ndim;j++){
-			double dmin=cc[j]-ss[j];
-			double dmax=cc[j]+ss[j];
-			double ddiv=ss[j]/double(ndiv);
-			if(dmin<vmin[j])vmin[j]=dmin; 
-			if(dmax>vmax[j])vmax[j]=dmax; 
-			if(ddiv<binsize[j])binsize[j]=ddiv;		
-		}
-	}
 	for(int j=0;j<ndim;j++){
 		// reset to periodicity
 		if(values[j]->isPeriodic()){
@@ -256,16 +303,21 @@ void BiasRepresentation::getMinMaxBin(vector<double> &vmin, vector<double> &vmax
 			if(minv>vmin[j])vmin[j]=minv;
 			if(maxv<vmax[j])vmax[j]=maxv;
 		}
-		vbin[j]=static_cast<unsigned>(ceil((vmax[j]-vmin[j])/binsize[j]) );	
+		vbin[j]=static_cast<unsigned>(ceil((vmax[j]-vmin[j])/kbinsize[j]) );	
 	}
 }
 void BiasRepresentation::clear(){
         // clear the hills
-	for(const auto & it : hills)
+	for(const auto & it : pending)
         {
 	    delete it;
         } 
-        hills.clear(); 
+        pending.clear(); 
+        pendingfactor.clear();
+        nkernels=0;
+	kmin.assign(ndim,10.e20);
+	kmax.assign(ndim,-10.e20);
+	kbinsize.assign(ndim,10.e20);
         // clear the grid
         if(hasgrid){
               BiasGrid_->clear();
@@ -38,6 +38,9 @@ namespace PLMD{
 /// this class implements a general purpose class that aims to 
 /// provide a Grid/list  
 /// transparently add gaussians to a bias  
+/// kernels are not stored: they are added to the grid in chunks
+/// and only their number and their extension are kept, so that
+/// the memory does not grow with the number of kernels
 
 class BiasRepresentation {
   public:
@@ -47,7 +50,7 @@ class BiasRepresentation {
 	  BiasRepresentation(const std::vector<Value*> & tmpvalues, Communicator &cc  ,  const std::vector<double> & sigma); 
           /// create a bias containing a grid representation 
 	  BiasRepresentation(const std::vector<Value*> & tmpvalues, Communicator &cc , const std::vector<std::string> &  gmin, const std::vector<std::string> & gmax, 
-                             const std::vector<unsigned> & nbin, bool doInt, double lowI_, double uppI_);
+                             const std::vector<unsigned> & nbin, bool doInt, double lowI_, double uppI_, bool usederiv=true);
           /// create a histogram with grid representation and sigmas in input
 	  BiasRepresentation(const std::vector<Value*> & tmpvalues, Communicator &cc , const std::vector<std::string> & gmin, const std::vector<std::string> & gmax, const std::vector<unsigned> & nbin , const std::vector<double> & sigma);
 	  /// destructor
@@ -55,7 +58,7 @@ class BiasRepresentation {
           /// retrieve the number of dimension of the representation
 	  unsigned 	getNumberOfDimensions();
           /// add the grid to the representation
-	  void 		addGrid(const std::vector<std::string> & gmin, const std::vector<std::string> & gmax, const std::vector<unsigned> & nbin );
+	  void 		addGrid(const std::vector<std::string> & gmin, const std::vector<std::string> & gmax, const std::vector<unsigned> & nbin, bool usederiv=true );
           /// push a kernel on the representation (includes widths and height)
 	  void 		pushKernel( IFile * ff);
           /// set the flag that rescales the free energy to the bias 
@@ -74,8 +77,10 @@ class BiasRepresentation {
           const std::string & getName(unsigned i);
           /// get a pointer to a specific value
 	  Value* 	getPtrToValue(unsigned i);
-          /// get the pointer to the grid
+          /// get the pointer to the grid (kernels that were read are added first)
 	  Grid* 	getGridPtr();
+          /// add to the grid the kernels that were read and not added yet
+          void 		depositKernels();
           /// get a new histogram point from a file 
           KernelFunctions* readFromPoint(IFile *ifile); 
           /// get an automatic min/max from the set so to know how to configure the grid
@@ -91,11 +96,20 @@ class BiasRepresentation {
     double uppI_;
     std::vector<Value*> values;
     std::vector<std::string> names;
-    std::vector<KernelFunctions*> hills;
-    std::vector<double> biasf;
+    /// number of kernels read
+    int nkernels;
+    /// kernels read and not added to the grid yet, with the factor used to rescale them to the bias
+    std::vector<KernelFunctions*> pending;
+    std::vector<double> pendingfactor;
+    /// extension of the kernels read and minimum bin size, see getMinMaxBin()
+    std::vector<double> kmin,kmax,kbinsize;
     std::vector<double> histosigma;	
     Communicator& mycomm;
     Grid* BiasGrid_;
+    /// add a kernel to the grid, splitting the grid points over the processes
+    void depositKernel(const KernelFunctions* kk, double factor, std::vector<Value*> & vals, Grid::index_t first, Grid::index_t last);
+    /// update the extension of the kernels read with a new one
+    void updateMinMax(const KernelFunctions* kk);
 };
 
 }
@@ -152,6 +152,25 @@ void Communicator::Sum(Data data){
 #endif
 }
 
+// data should be passed by value to allow conversions
+// cppcheck-suppress passedByValue
+Communicator::Request Communicator::Isum(Data data){
+  Request req;
+#ifdef __PLUMED_HAS_MPI
+  plumed_massert(initialized(),"you are trying to use an MPI function, but MPI is not initialized");
+#if MPI_VERSION>=3
+  MPI_Iallreduce(MPI_IN_PLACE,data.pointer,data.size,data.type,MPI_SUM,communicator,&req.r);
+#else
+  MPI_Allreduce(MPI_IN_PLACE,data.pointer,data.size,data.type,MPI_SUM,communicator);
+  req.r=MPI_REQUEST_NULL;
+#endif
+#else
+  (void) data;
+  plumed_merror("you are trying to use an MPI function, but PLUMED has been compiled without MPI support");
+#endif
+  return req;
+}
+
 // data should be passed by value to allow conversions
 // cppcheck-suppress passedByValue
 Communicator::Request Communicator::Isend(ConstData data,int source,int tag){
@@ -189,6 +208,33 @@ void Communicator::Allgatherv(ConstData in,Data out,const int*recvcounts,const i
 #endif
 }
 
+// data should be passed by value to allow conversions
+// cppcheck-suppress passedByValue
+Communicator::Request Communicator::Iallgatherv(ConstData in,Data out,const int*recvcounts,const int*displs){
+  Request req;
+#if defined(__PLUMED_HAS_MPI)
+  plumed_massert(initialized(),"you are trying to use an MPI function, but MPI is not initialized");
+  void*s=const_cast<void*>((const void*)in.pointer);
+  void*r=const_cast<void*>((const void*)out.pointer);
+  int*rc=const_cast<int*>(recvcounts);
+  int*di=const_cast<int*>(displs);
+  if(s==NULL)s=MPI_IN_PLACE;
+#if MPI_VERSION>=3
+  MPI_Iallgatherv(s,in.size,in.type,r,rc,di,out.type,communicator,&req.r);
+#else
+  MPI_Allgatherv(s,in.size,in.type,r,rc,di,out.type,communicator);
+  req.r=MPI_REQUEST_NULL;
+#endif
+#else
+  (void) in;
+  (void) out;
+  (void) recvcounts;
+  (void) displs;
+  plumed_merror("you are trying to use an MPI function, but PLUMED has been compiled without MPI support");
+#endif
+  return req;
+}
+
 // data should be passed by value to allow conversions
 // cppcheck-suppress passedByValue
 void Communicator::Allgather(ConstData in,Data out){
@@ -244,6 +290,16 @@ bool Communicator::initialized(){
   else return false;
 }
 
+bool Communicator::threadMultiple(){
+  if(!initialized()) return true;
+  int provided=0;
+#if defined(__PLUMED_HAS_MPI)
+  MPI_Query_thread(&provided);
+  if(provided==MPI_THREAD_MULTIPLE) return true;
+#endif
+  return false;
+}
+
 void Communicator::Request::wait(Status&s){
 #ifdef __PLUMED_HAS_MPI
  plumed_massert(initialized(),"you are trying to use an MPI function, but MPI is not initialized");
@@ -171,6 +171,9 @@ public:
   void Barrier()const;
 /// Tests if MPI library is initialized
   static bool initialized();
+/// Tests if MPI can be called from several threads at the same time,
+/// that is if MPI is not initialized or it provides MPI_THREAD_MULTIPLE
+  static bool threadMultiple();
 
 /// Returns MPI_COMM_WORLD if MPI is initialized, otherwise the default communicator
   static Communicator & Get_world();
@@ -182,6 +185,15 @@ public:
 /// Wrapper for MPI_Allreduce with MPI_SUM (reference)
   template <class T> void Sum(T&buf){Sum(Data(buf));}
 
+/// Wrapper for MPI_Iallreduce with MPI_SUM (data struct).
+/// The result is available after the returned request has been waited.
+/// With MPI libraries not supporting non-blocking collectives this is a blocking call.
+  Request Isum(Data);
+/// Wrapper for MPI_Iallreduce with MPI_SUM (pointer)
+  template <class T> Request Isum(T*buf,int count){return Isum(Data(buf,count));}
+/// Wrapper for MPI_Iallreduce with MPI_SUM (reference)
+  template <class T> Request Isum(T&buf){return Isum(Data(buf));}
+
 /// Wrapper for MPI_Bcast (data struct)
   void Bcast(Data,int);
 /// Wrapper for MPI_Bcast (pointer)
@@ -205,6 +217,17 @@ public:
   template <class T,class S> void Allgatherv(const T&sendbuf,S&recvbuf,const int*recvcounts,const int*displs){
     Allgatherv(ConstData(sendbuf),Data(recvbuf),recvcounts,displs);}
 
+/// Wrapper for MPI_Iallgatherv (data struct).
+/// Buffers, counts and displacements should not be touched until the returned request has been waited.
+/// With MPI libraries not supporting non-blocking collectives this is a blocking call.
+  Request Iallgatherv(ConstData in,Data out,const int*,const int*);
+/// Wrapper for MPI_Iallgatherv (pointer)
+  template <class T,class S> Request Iallgatherv(const T*sendbuf,int sendcount,S*recvbuf,const int*recvcounts,const int*displs){
+    return Iallgatherv(ConstData(sendbuf,sendcount),Data(recvbuf,0),recvcounts,displs);}
+/// Wrapper for MPI_Iallgatherv (reference)
+  template <class T,class S> Request Iallgatherv(const T&sendbuf,S&recvbuf,const int*recvcounts,const int*displs){
+    return Iallgatherv(ConstData(sendbuf),Data(recvbuf),recvcounts,displs);}
+
 /// Wrapper for MPI_Allgather (data struct)
   void Allgather(ConstData in,Data out);
 /// Wrapper for MPI_Allgatherv (pointer)
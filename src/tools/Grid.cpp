@@ -28,6 +28,7 @@
 #include "KernelFunctions.h"
 #include "RootFindingBase.h"
 #include "Communicator.h"
+#include "OpenMP.h"
 
 #include <vector>
 #include <cmath>
@@ -35,10 +36,74 @@
 #include <sstream>
 #include <cstdio>
 #include <cfloat>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+#ifdef __PLUMED_HAS_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 namespace PLMD{
 
+/// First line of binary grid files
+static const std::string binaryGridMagic="#! PLUMED BINARY GRID 1\n";
+
+/// Read-only view of a whole file, memory mapped when possible
+class GridFileView{
+  const char* data_;
+  size_t size_;
+  bool mapped_;
+  std::vector<char> buffer_;
+public:
+  explicit GridFileView(const std::string& path);
+  ~GridFileView();
+  const char* data()const{return data_;}
+  size_t size()const{return size_;}
+};
+
+GridFileView::GridFileView(const std::string& path):
+  data_(NULL),
+  size_(0),
+  mapped_(false)
+{
+#ifdef __PLUMED_HAS_MMAP
+  int fd=open(path.c_str(),O_RDONLY);
+  plumed_massert(fd>=0,"cannot open grid file "+path);
+  struct stat st;
+  if(fstat(fd,&st)==0 && st.st_size>0){
+    void* p=mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+    if(p!=MAP_FAILED){
+      data_=static_cast<const char*>(p);
+      size_=st.st_size;
+      mapped_=true;
+    }
+  }
+  close(fd);
+  if(mapped_) return;
+#endif
+  FILE* fp=std::fopen(path.c_str(),"rb");
+  plumed_massert(fp,"cannot open grid file "+path);
+  std::fseek(fp,0,SEEK_END);
+  long n=std::ftell(fp);
+  std::fseek(fp,0,SEEK_SET);
+  buffer_.resize(n>0?n:0);
+  if(n>0) plumed_massert(std::fread(&buffer_[0],1,n,fp)==size_t(n),"error reading grid file "+path);
+  std::fclose(fp);
+  data_=(buffer_.empty()?NULL:&buffer_[0]);
+  size_=buffer_.size();
+}
+
+GridFileView::~GridFileView(){
+#ifdef __PLUMED_HAS_MMAP
+  if(mapped_) munmap(const_cast<char*>(data_),size_);
+#endif
+}
+
 Grid::Grid(const std::string& funcl, const std::vector<Value*> & args, const vector<std::string> & gmin, 
            const vector<std::string> & gmax, const vector<unsigned> & nbin, bool dospline, bool usederiv, bool doclear){
 // various checks
@@ -107,6 +172,7 @@ void Grid::Init(const std::string& funcl, const std::vector<std::string> &names,
  dospline_=dospline;
  usederiv_=usederiv;
  if(dospline_) plumed_assert(dospline_==usederiv_);
+ stride_=(usederiv_ ? dimension_+1 : 1);
  maxsize_=1;
  for(unsigned int i=0;i<dimension_;++i){
   dx_.push_back( (max_[i]-min_[i])/static_cast<double>( nbin_[i] ) );
@@ -117,15 +183,7 @@ void Grid::Init(const std::string& funcl, const std::vector<std::string> &names,
 }
 
 void Grid::clear(){
- grid_.resize(maxsize_);
- if(usederiv_) der_.resize(maxsize_);
- for(index_t i=0;i<maxsize_;++i){
-  grid_[i]=0.0;
-  if(usederiv_){
-   (der_[i]).resize(dimension_); 
-   for(unsigned int j=0;j<dimension_;++j) der_[i][j]=0.0;
-  }
- }
+ grid_.assign(maxsize_*stride_,0.0);
 }
 
 vector<std::string> Grid::getMin() const {
@@ -167,6 +225,22 @@ unsigned Grid::getDimension() const {
  return dimension_;
 }
 
+bool Grid::hasDerivatives() const {
+ return usederiv_;
+}
+
+void Grid::writeBinary(std::ostream&o)const{
+ Tools::writeBinary(o,grid_);
+}
+
+void Grid::readBinary(std::istream&i){
+ vector<double> data;
+ Tools::readBinary(i,data);
+ if(!i) return;
+ plumed_massert(data.size()==grid_.size(),"grid data in the checkpoint are not consistent with the grid");
+ grid_.swap(data);
+}
+
 // we are flattening arrays using a column-major order
 Grid::index_t Grid::getIndex(const vector<unsigned> & indices) const {
  plumed_dbg_assert(indices.size()==dimension_);
@@ -356,13 +430,18 @@ void Grid::addKernel( const KernelFunctions& kernel ){
 
 double Grid::getValue(index_t index) const {
  plumed_dbg_assert(index<maxsize_);
- return grid_[index];
+ return grid_[index*stride_];
+}
+
+const double* Grid::getValueAndDerivativesPointer(index_t index) const {
+ plumed_dbg_assert(index<maxsize_);
+ return &grid_[index*stride_];
 }
 
 double Grid::getMinValue() const {
  double minval;
  minval=DBL_MAX;
- for(index_t i=0;i<grid_.size();++i){
+ for(index_t i=0;i<grid_.size();i+=stride_){
 	 if(grid_[i]<minval)minval=grid_[i];
  }
  return minval;
@@ -371,13 +450,88 @@ double Grid::getMinValue() const {
 double Grid::getMaxValue() const {
  double maxval;
  maxval=DBL_MIN;
- for(index_t i=0;i<grid_.size();++i){
+ for(index_t i=0;i<grid_.size();i+=stride_){
 	 if(grid_[i]>maxval)maxval=grid_[i];
  }
  return maxval;
 }
 
 
+// same algorithm as the generic implementation in getValueAndDerivatives(),
+// with all the temporaries on the stack and the neighbors enumerated directly
+template<unsigned dim>
+double Grid::getSplineValueAndDerivatives(const vector<double> & x, double* der) const {
+ plumed_dbg_assert(x.size()==dim && dimension_==dim && usederiv_);
+ unsigned indices[dim],nindices[dim][2];
+ bool valid[dim][2];
+ double sign[dim][2],h0[dim][2],h1[dim][2],g0[dim][2],g1[dim][2];
+ bool empty=false,outside=false;
+ for(unsigned j=0;j<dim;++j){
+  der[j]=0.0;
+  indices[j]=unsigned(floor((x[j]-min_[j])/dx_[j]));
+  double xfloor=min_[j]+(double)(indices[j])*dx_[j];
+  for(unsigned k=0;k<2;++k){
+   unsigned i0=indices[j]+k;
+   valid[j][k]=true;
+   if(i0==nbin_[j]){ if(pbc_[j]) i0=0; else valid[j][k]=false; }
+   if(valid[j][k] && i0>=nbin_[j]) outside=true;
+   nindices[j][k]=i0;
+   int x0=1;
+   if(i0==indices[j]) x0=0;
+   double X=fabs((x[j]-xfloor)/dx_[j]-(double)x0);
+   double X2=X*X;
+   double X3=X2*X;
+   sign[j][k]=(x0?-1.0:1.0);
+   h0[j][k]=(1.0-3.0*X2+2.0*X3);
+   h1[j][k]=(X-2.0*X2+X3);
+   g0[j][k]=( -6.0*X +6.0*X2);
+   g1[j][k]=(1.0-4.0*X +3.0*X2);
+  }
+  if(!valid[j][0] && !valid[j][1]) empty=true;
+ }
+ if(empty) return 0.0;
+ if(outside){
+// let getIndex() report the point outside the grid
+  vector<unsigned> bad(dim);
+  for(unsigned j=0;j<dim;++j) bad[j]=(valid[j][1] && nindices[j][1]>=nbin_[j] ? nindices[j][1] : (valid[j][0] ? nindices[j][0] : nindices[j][1]));
+  getIndex(bad);
+ }
+
+ double value=0.0;
+ for(unsigned ipoint=0;ipoint<(1u<<dim);++ipoint){
+  unsigned k[dim];
+  bool skip=false;
+  for(unsigned j=0;j<dim;++j){
+   k[j]=(ipoint>>j)&1;
+   if(!valid[j][k[j]]) skip=true;
+  }
+  if(skip) continue;
+  index_t index=nindices[dim-1][k[dim-1]];
+  for(unsigned j=dim-1;j>0;--j) index=index*nbin_[j-1]+nindices[j-1][k[j-1]];
+  const double* p=getValueAndDerivativesPointer(index);
+  double grid=(p ? p[0] : 0.0);
+  double C[dim],D[dim];
+  double ff=1.0;
+  for(unsigned j=0;j<dim;++j){
+   double yy;
+   if(fabs(grid)<0.0000001) yy=0.0;
+     else yy=-p[1+j]/grid;
+   const double s=sign[j][k[j]];
+   C[j]=h0[j][k[j]] - s*yy*h1[j][k[j]]*dx_[j];
+   D[j]=g0[j][k[j]] - s*yy*g1[j][k[j]]*dx_[j];
+   D[j]*=s/dx_[j];
+   ff*=C[j];
+  }
+  value+=grid*ff;
+  for(unsigned j=0;j<dim;++j){
+   double fd=D[j];
+   for(unsigned i=0;i<dim;++i) if(i!=j) fd*=C[i];
+   der[j]+=grid*fd;
+  }
+ }
+ return value;
+}
+
 double Grid::getValue(const vector<unsigned> & indices) const {
  return getValue(getIndex(indices));
 }
@@ -386,16 +540,24 @@ double Grid::getValue(const vector<double> & x) const {
  if(!dospline_){
   return getValue(getIndex(x));
  } else {
-  vector<double> der(dimension_);
-  return getValueAndDerivatives(x,der);
+  double der[4];
+  switch(dimension_){
+   case 1: return getSplineValueAndDerivatives<1>(x,der);
+   case 2: return getSplineValueAndDerivatives<2>(x,der);
+   case 3: return getSplineValueAndDerivatives<3>(x,der);
+   case 4: return getSplineValueAndDerivatives<4>(x,der);
+  }
+  vector<double> vder(dimension_);
+  return getValueAndDerivatives(x,vder);
  }
 }
 
 double Grid::getValueAndDerivatives
  (index_t index, vector<double>& der) const{
  plumed_dbg_assert(index<maxsize_ && usederiv_ && der.size()==dimension_);
- der=der_[index];
- return grid_[index];
+ const double* p=&grid_[index*stride_];
+ for(unsigned int i=0;i<dimension_;++i) der[i]=p[1+i];
+ return p[0];
 }
 
 double Grid::getValueAndDerivatives
@@ -408,6 +570,12 @@ double Grid::getValueAndDerivatives
  plumed_dbg_assert(der.size()==dimension_ && usederiv_);
  
  if(dospline_){
+  switch(dimension_){
+   case 1: return getSplineValueAndDerivatives<1>(x,&der[0]);
+   case 2: return getSplineValueAndDerivatives<2>(x,&der[0]);
+   case 3: return getSplineValueAndDerivatives<3>(x,&der[0]);
+   case 4: return getSplineValueAndDerivatives<4>(x,&der[0]);
+  }
   double X,X2,X3,value;
   vector<double> fd(dimension_);
   vector<double> C(dimension_);
@@ -457,7 +625,7 @@ double Grid::getValueAndDerivatives
 
 void Grid::setValue(index_t index, double value){
  plumed_dbg_assert(index<maxsize_ && !usederiv_);
- grid_[index]=value;
+ grid_[index*stride_]=value;
 }
 
 void Grid::setValue(const vector<unsigned> & indices, double value){
@@ -467,8 +635,9 @@ void Grid::setValue(const vector<unsigned> & indices, double value){
 void Grid::setValueAndDerivatives
  (index_t index, double value, vector<double>& der){
  plumed_dbg_assert(index<maxsize_ && usederiv_ && der.size()==dimension_);
- grid_[index]=value;
- der_[index]=der;
+ double* p=&grid_[index*stride_];
+ p[0]=value;
+ for(unsigned int i=0;i<dimension_;++i) p[1+i]=der[i];
 }
 
 void Grid::setValueAndDerivatives
@@ -478,7 +647,7 @@ void Grid::setValueAndDerivatives
 
 void Grid::addValue(index_t index, double value){
  plumed_dbg_assert(index<maxsize_ && !usederiv_);
- grid_[index]+=value;
+ grid_[index*stride_]+=value;
 }
 
 void Grid::addValue(const vector<unsigned> & indices, double value){
@@ -488,8 +657,9 @@ void Grid::addValue(const vector<unsigned> & indices, double value){
 void Grid::addValueAndDerivatives
  (index_t index, double value, vector<double>& der){
  plumed_dbg_assert(index<maxsize_ && usederiv_ && der.size()==dimension_);
- grid_[index]+=value;
- for(unsigned int i=0;i<dimension_;++i) der_[index][i]+=der[i];
+ double* p=&grid_[index*stride_];
+ p[0]+=value;
+ for(unsigned int i=0;i<dimension_;++i) p[1+i]+=der[i];
 }
 
 void Grid::addValueAndDerivatives
@@ -498,41 +668,26 @@ void Grid::addValueAndDerivatives
 }
 
 void Grid::scaleAllValuesAndDerivatives( const double& scalef ){
-  if(usederiv_){
-     for(index_t i=0;i<grid_.size();++i){
-         grid_[i]*=scalef;
-         for(unsigned j=0;j<dimension_;++j) der_[i][j]*=scalef;
-     }
-  } else {
-     for(index_t i=0;i<grid_.size();++i) grid_[i]*=scalef;
-  }
+  for(index_t i=0;i<grid_.size();++i) grid_[i]*=scalef;
 }
 
 void Grid::logAllValuesAndDerivatives( const double& scalef ){
-  if(usederiv_){
-     for(index_t i=0;i<grid_.size();++i){
-         grid_[i] = scalef*log(grid_[i]);
-         for(unsigned j=0;j<dimension_;++j) der_[i][j] = scalef/der_[i][j];
-     }
-  } else {
-     for(index_t i=0;i<grid_.size();++i) grid_[i] = scalef*log(grid_[i]);
+  for(index_t i=0;i<grid_.size();i+=stride_){
+     grid_[i] = scalef*log(grid_[i]);
+     for(unsigned j=1;j<stride_;++j) grid_[i+j] = scalef/grid_[i+j];
   }
 }
 
 void Grid::setMinToZero(){
   double min=grid_[0];
-  for(index_t i=1;i<grid_.size();++i) if(grid_[i]<min) min=grid_[i];
-  for(index_t i=0;i<grid_.size();++i) grid_[i] -= min; 
+  for(index_t i=stride_;i<grid_.size();i+=stride_) if(grid_[i]<min) min=grid_[i];
+  for(index_t i=0;i<grid_.size();i+=stride_) grid_[i] -= min; 
 }
 
 void Grid::applyFunctionAllValuesAndDerivatives( double (*func)(double val), double (*funcder)(double valder) ){
-  if(usederiv_){
-     for(index_t i=0;i<grid_.size();++i){
-         grid_[i]=func(grid_[i]);
-         for(unsigned j=0;j<dimension_;++j) der_[i][j]=funcder(der_[i][j]);
-     }
-  } else {
-     for(index_t i=0;i<grid_.size();++i) grid_[i]=func(grid_[i]);
+  for(index_t i=0;i<grid_.size();i+=stride_){
+     grid_[i]=func(grid_[i]);
+     for(unsigned j=1;j<stride_;++j) grid_[i+j]=funcder(grid_[i+j]);
   }
 }
 
@@ -569,6 +724,43 @@ void Grid::writeToFile(OFile& ofile){
  }
 }
 
+// Binary files start with a short text header, padded so that the data are aligned
+// to 8 bytes. The header is followed by the number 1.0, which is used to check the byte order,
+// by the indexes of the points (only if not all the points are stored), and by the value
+// and the derivatives (if any) of each point.
+void Grid::writeBinaryHeader(OFile& ofile, index_t npoints){
+ std::string header=binaryGridMagic;
+ header+="#! FUNCTION "+funcname+"\n";
+ header+=std::string("#! DERIVATIVES ")+(usederiv_?"true":"false")+"\n";
+ std::string n; Tools::convert(npoints,n);
+ header+="#! POINTS "+n+"\n";
+ for(unsigned j=0;j<dimension_;++j){
+   std::string nb; Tools::convert(nbin_[j],nb);
+   header+="#! CV "+argnames[j]+" "+str_min_[j]+" "+str_max_[j]+" "+nb+" "+(pbc_[j]?"true":"false")+"\n";
+ }
+ header+="#! END";
+ while((header.length()+1)%8!=0) header+=" ";
+ header+="\n";
+ const double one=1.0;
+ ofile.write(header.c_str(),header.length());
+ ofile.write(reinterpret_cast<const char*>(&one),sizeof(double));
+}
+
+void Grid::writeToBinaryFile(OFile& ofile){
+ writeBinaryHeader(ofile,maxsize_);
+// values and derivatives are already stored as in the file, so they are written at once
+ if(!grid_.empty()) ofile.write(reinterpret_cast<const char*>(&grid_[0]),grid_.size()*sizeof(double));
+}
+
+bool Grid::isBinaryFile(const std::string& path){
+ FILE* fp=std::fopen(path.c_str(),"rb");
+ if(!fp) return false;
+ std::vector<char> magic(binaryGridMagic.length());
+ size_t n=std::fread(&magic[0],1,magic.size(),fp);
+ std::fclose(fp);
+ return n==magic.size() && std::string(magic.begin(),magic.end())==binaryGridMagic;
+}
+
 void Grid::writeCubeFile(OFile& ofile, const double& lunit){
   plumed_assert( dimension_==3 );
   ofile.printf("PLUMED CUBE FILE\n");
@@ -611,6 +803,7 @@ Grid* Grid::create(const std::string& funcl, const std::vector<Value*> & args, I
 
 Grid* Grid::create(const std::string& funcl, const std::vector<Value*> & args, IFile& ifile, bool dosparse, bool dospline, bool doder)
 {
+ if(isBinaryFile(ifile.getPath())) return createFromBinary(funcl,args,ifile.getPath(),dosparse,dospline,doder);
  Grid* grid=NULL;
  unsigned nvar=args.size(); bool hasder=false; std::string pstring;
  std::vector<int> gbin1(nvar); std::vector<unsigned> gbin(nvar); 
@@ -668,13 +861,103 @@ Grid* Grid::create(const std::string& funcl, const std::vector<Value*> & args, I
  return grid;
 }
 
-// Sparse version of grid with map
+Grid* Grid::createFromBinary(const std::string& funcl, const std::vector<Value*> & args, const std::string& path, bool dosparse, bool dospline, bool doder)
+{
+ GridFileView file(path);
+ const char* p=file.data();
+ const char* end=p+file.size();
+// parse the header, one line at a time
+ unsigned nvar=args.size(); bool hasder=false; bool hasfunc=false; unsigned ncv=0;
+ index_t npoints=0;
+ std::vector<unsigned> gbin(nvar);
+ std::vector<std::string> gmin(nvar),gmax(nvar);
+ while(true){
+   const char* eol=static_cast<const char*>(std::memchr(p,'\n',end-p));
+   plumed_massert(eol,"truncated header in binary grid file "+path);
+   std::vector<std::string> words=Tools::getWords(std::string(p,eol));
+   p=eol+1;
+   plumed_massert(words.size()>=2 && words[0]=="#!","wrong header in binary grid file "+path);
+   if(words[1]=="END") break;
+   else if(words[1]=="FUNCTION"){ plumed_assert(words.size()==3); hasfunc=(words[2]==funcl); }
+   else if(words[1]=="DERIVATIVES"){ plumed_assert(words.size()==3); hasder=(words[2]=="true"); }
+   else if(words[1]=="POINTS"){
+     long int n=-1;
+     bool ok=(words.size()==3 && Tools::convert(words[2],n));
+     plumed_assert(ok && n>=0);
+     npoints=n;
+   }
+   else if(words[1]=="CV"){
+     plumed_assert(words.size()==7);
+     plumed_massert(ncv<nvar && words[2]==args[ncv]->getName(),"arguments in input are not in same order as in grid file");
+     gmin[ncv]=words[3]; gmax[ncv]=words[4];
+     int nb; Tools::convert(words[5],nb); plumed_assert( nb>0 );
+     if( args[ncv]->isPeriodic() ){
+         plumed_massert( words[6]=="true", "input value is periodic but grid is not");
+         std::string pmin, pmax;
+         args[ncv]->getDomain( pmin, pmax ); gbin[ncv]=nb;
+         if( pmin!=gmin[ncv] || pmax!=gmax[ncv] ) plumed_merror("mismatch between grid boundaries and periods of values");
+     } else {
+         gbin[ncv]=nb-1;  // as in text files, one more bin is indicated when data is not periodic
+         plumed_massert( words[6]=="false", "input value is not periodic but grid is");
+     }
+     ncv++;
+   }
+ }
+ plumed_massert( hasfunc , "no column labelled " + funcl + " in in grid input");
+ plumed_massert( ncv==nvar, "number of arguments in input does not match grid file");
+ if( doder && !hasder ) plumed_merror("missing derivatives from grid file");
+
+ Grid* grid=NULL;
+ if(!dosparse){grid=new Grid(funcl,args,gmin,gmax,gbin,dospline,doder);}
+ else{grid=new SparseGrid(funcl,args,gmin,gmax,gbin,dospline,doder);}
+
+ const bool allpoints=(npoints==grid->maxsize_);
+ const unsigned fstride=(hasder ? nvar+1 : 1);
+ const size_t expected=sizeof(double)+(allpoints?0:npoints*sizeof(uint64_t))+npoints*fstride*sizeof(double);
+ plumed_massert(size_t(end-p)==expected,"wrong size of binary grid file "+path);
+ double one; std::memcpy(&one,p,sizeof(double)); p+=sizeof(double);
+ plumed_massert(one==1.0,"binary grid file "+path+" was written on a machine with a different byte order");
+ const char* indexes=p;
+ const char* data=p+(allpoints?0:npoints*sizeof(uint64_t));
+
+ if(allpoints && !dosparse && fstride==grid->stride_){
+   if(!grid->grid_.empty()) std::memcpy(&grid->grid_[0],data,grid->grid_.size()*sizeof(double));
+   return grid;
+ }
+ vector<double> point(fstride),dder(nvar);
+ for(index_t i=0;i<npoints;++i){
+   index_t index=i;
+   if(!allpoints){ uint64_t k; std::memcpy(&k,indexes+i*sizeof(uint64_t),sizeof(uint64_t)); index=k; }
+   plumed_massert(index<grid->maxsize_,"point outside the grid in binary grid file "+path);
+   std::memcpy(&point[0],data+i*fstride*sizeof(double),fstride*sizeof(double));
+   if(doder){
+     for(unsigned j=0;j<nvar;++j) dder[j]=point[1+j];
+     grid->setValueAndDerivatives(index,point[0],dder);
+   } else grid->setValue(index,point[0]);
+ }
+ return grid;
+}
+
+// Sparse version of grid with hashed tiles
+static const Grid::index_t emptyTile=~Grid::index_t(0);
+
+static inline Grid::index_t hashTile(Grid::index_t tile){
+// multiplicative (Fibonacci) hashing
+ return (tile*Grid::index_t(11400714819323198485ull))>>16;
+}
+
 void SparseGrid::clear(){
- map_.clear();
+ tiles_.clear();
+ stored_.clear();
+ hashKeys_.clear();
+ hashTiles_.clear();
+ ntiles_=0;
+ npoints_=0;
+ lastTile_=emptyTile;
 }
 
 Grid::index_t SparseGrid::getSize() const{
- return map_.size(); 
+ return npoints_; 
 }
 
 Grid::index_t SparseGrid::getMaxSize() const {
@@ -728,49 +1011,148 @@ void Grid::findSetOfPointsOnContour(const double& target, const std::vector<bool
  } 
 }
 
+unsigned SparseGrid::findTile(index_t tile)const{
+ if(hashKeys_.empty()) return ntiles_;
+ const index_t mask=hashKeys_.size()-1;
+ for(index_t h=hashTile(tile)&mask;;h=(h+1)&mask){
+  if(hashKeys_[h]==tile) return hashTiles_[h];
+  if(hashKeys_[h]==emptyTile) return ntiles_;
+ }
+}
+
+double* SparseGrid::touchPoint(index_t index){
+ const index_t tile=index/tileSize_;
+ unsigned itile=(tile==lastTile_ ? lastTilePos_ : findTile(tile));
+ if(itile==ntiles_){
+// keep the table at most half full, rehashing when it grows
+  if(2*(ntiles_+1)>hashKeys_.size()){
+   vector<index_t> oldKeys(max<size_t>(64,2*hashKeys_.size()),emptyTile);
+   vector<unsigned> oldTiles(oldKeys.size());
+   oldKeys.swap(hashKeys_); oldTiles.swap(hashTiles_);
+   const index_t mask=hashKeys_.size()-1;
+   for(index_t k=0;k<oldKeys.size();++k){
+    if(oldKeys[k]==emptyTile) continue;
+    index_t h=hashTile(oldKeys[k])&mask;
+    while(hashKeys_[h]!=emptyTile) h=(h+1)&mask;
+    hashKeys_[h]=oldKeys[k]; hashTiles_[h]=oldTiles[k];
+   }
+  }
+  const index_t mask=hashKeys_.size()-1;
+  index_t h=hashTile(tile)&mask;
+  while(hashKeys_[h]!=emptyTile) h=(h+1)&mask;
+  hashKeys_[h]=tile; hashTiles_[h]=ntiles_;
+  tiles_.resize(tiles_.size()+tileSize_*stride_,0.0);
+  stored_.resize(stored_.size()+tileSize_,0);
+  ntiles_++;
+ }
+ lastTile_=tile; lastTilePos_=itile;
+ const size_t k=size_t(itile)*tileSize_+index%tileSize_;
+ if(!stored_[k]){ stored_[k]=1; npoints_++; }
+ return &tiles_[k*stride_];
+}
+
 double SparseGrid::getValue(index_t index)const{
  plumed_assert(index<maxsize_);
- double value=0.0;
- const auto it=map_.find(index);
- if(it!=map_.end()) value=it->second;
- return value;
+ const double* p=getValueAndDerivativesPointer(index);
+ return (p ? p[0] : 0.0);
+}
+
+const double* SparseGrid::getValueAndDerivativesPointer(index_t index)const{
+ plumed_dbg_assert(index<maxsize_);
+ const unsigned itile=findTile(index/tileSize_);
+ if(itile==ntiles_) return NULL;
+ return &tiles_[(size_t(itile)*tileSize_+index%tileSize_)*stride_];
 }
 
 double SparseGrid::getValueAndDerivatives
  (index_t index, vector<double>& der)const{
  plumed_assert(index<maxsize_ && usederiv_ && der.size()==dimension_);
- double value=0.0;
- for(unsigned int i=0;i<dimension_;++i) der[i]=0.0;
- const auto it=map_.find(index);
- if(it!=map_.end()) value=it->second;
- const auto itder=der_.find(index);
- if(itder!=der_.end()) der=itder->second;
- return value;
+ const double* p=getValueAndDerivativesPointer(index);
+ if(!p){
+  for(unsigned int i=0;i<dimension_;++i) der[i]=0.0;
+  return 0.0;
+ }
+ for(unsigned int i=0;i<dimension_;++i) der[i]=p[1+i];
+ return p[0];
 }
 
 void SparseGrid::setValue(index_t index, double value){
  plumed_assert(index<maxsize_ && !usederiv_);
- map_[index]=value;
+ touchPoint(index)[0]=value;
 }
 
 void SparseGrid::setValueAndDerivatives
  (index_t index, double value, vector<double>& der){
  plumed_assert(index<maxsize_ && usederiv_ && der.size()==dimension_);
- map_[index]=value;
- der_[index]=der;
+ double* p=touchPoint(index);
+ p[0]=value;
+ for(unsigned int i=0;i<dimension_;++i) p[1+i]=der[i];
 }
 
 void SparseGrid::addValue(index_t index, double value){
  plumed_assert(index<maxsize_ && !usederiv_);
- map_[index]+=value;
+ touchPoint(index)[0]+=value;
 }
 
 void SparseGrid::addValueAndDerivatives
  (index_t index, double value, vector<double>& der){
  plumed_assert(index<maxsize_ && usederiv_ && der.size()==dimension_);
- map_[index]+=value;
- der_[index].resize(dimension_);
- for(unsigned int i=0;i<dimension_;++i) der_[index][i]+=der[i]; 
+ double* p=touchPoint(index);
+ p[0]+=value;
+ for(unsigned int i=0;i<dimension_;++i) p[1+i]+=der[i]; 
+}
+
+vector<Grid::index_t> SparseGrid::getStoredPoints()const{
+ vector<index_t> points;
+ points.reserve(npoints_);
+ for(index_t h=0;h<hashKeys_.size();++h){
+   if(hashKeys_[h]==emptyTile) continue;
+   for(unsigned k=0;k<tileSize_;++k){
+     if(stored_[size_t(hashTiles_[h])*tileSize_+k]) points.push_back(hashKeys_[h]*tileSize_+k);
+   }
+ }
+ std::sort(points.begin(),points.end());
+ return points;
+}
+
+void SparseGrid::writeToBinaryFile(OFile& ofile){
+ const vector<index_t> points=getStoredPoints();
+ writeBinaryHeader(ofile,points.size());
+ if(points.size()==maxsize_){
+   vector<double> data(maxsize_*stride_);
+   for(index_t i=0;i<maxsize_;++i) std::memcpy(&data[i*stride_],getValueAndDerivativesPointer(i),stride_*sizeof(double));
+   if(!data.empty()) ofile.write(reinterpret_cast<const char*>(&data[0]),data.size()*sizeof(double));
+   return;
+ }
+ vector<uint64_t> indexes(points.begin(),points.end());
+ vector<double> data(points.size()*stride_);
+ for(index_t i=0;i<points.size();++i) std::memcpy(&data[i*stride_],getValueAndDerivativesPointer(points[i]),stride_*sizeof(double));
+ if(!indexes.empty()){
+   ofile.write(reinterpret_cast<const char*>(&indexes[0]),indexes.size()*sizeof(uint64_t));
+   ofile.write(reinterpret_cast<const char*>(&data[0]),data.size()*sizeof(double));
+ }
+}
+
+void SparseGrid::writeBinary(std::ostream&o)const{
+ const vector<index_t> points=getStoredPoints();
+ vector<double> data(points.size()*stride_);
+ for(index_t i=0;i<points.size();++i) std::memcpy(&data[i*stride_],getValueAndDerivativesPointer(points[i]),stride_*sizeof(double));
+ Tools::writeBinary(o,points);
+ Tools::writeBinary(o,data);
+}
+
+void SparseGrid::readBinary(std::istream&i){
+ vector<index_t> points;
+ vector<double> data;
+ Tools::readBinary(i,points);
+ Tools::readBinary(i,data);
+ if(!i) return;
+ plumed_massert(data.size()==points.size()*stride_,"grid data in the checkpoint are not consistent with the grid");
+ clear();
+ for(index_t k=0;k<points.size();++k){
+   plumed_massert(points[k]<maxsize_,"grid data in the checkpoint are not consistent with the grid");
+   std::memcpy(touchPoint(points[k]),&data[k*stride_],stride_*sizeof(double));
+ }
 }
 
 void SparseGrid::writeToFile(OFile& ofile){
@@ -779,8 +1161,8 @@ void SparseGrid::writeToFile(OFile& ofile){
  double f;
  writeHeader(ofile);
  ofile.fmtField(" "+fmt_);
- for(const auto & it : map_){
-   index_t i=it.first;
+ const vector<index_t> points=getStoredPoints();
+ for(const auto & i : points){
    xx=getPoint(i);
    if(usederiv_){f=getValueAndDerivatives(i,der);} 
    else{f=getValue(i);}
@@ -885,7 +1267,13 @@ Grid Grid::project(const std::vector<std::string> & proj , WeightBase *ptr2obj )
          //}
 
          // loop over all the points in the Grid, find the corresponding fixed index, rotate over all the other ones  
-         for(unsigned i=0;i<smallgrid.getSize();i++){
+         // points of the small grid are independent and are distributed over threads
+         unsigned nt=OpenMP::getNumThreads();
+         if(nt>smallgrid.getSize()) nt=1;
+         #pragma omp parallel num_threads(nt)
+         {
+           #pragma omp for schedule(dynamic)
+           for(unsigned i=0;i<smallgrid.getSize();i++){
                  std::vector<unsigned> v;
                  v=smallgrid.getIndices(i);
                  std::vector<int> vHigh((getArgNames()).size(),-1);   
@@ -894,6 +1282,7 @@ Grid Grid::project(const std::vector<std::string> & proj , WeightBase *ptr2obj )
                  double initval=0.;  
                  projectOnLowDimension(initval,vHigh, ptr2obj); 
                  smallgrid.setValue(i,initval);  
+           }
          }
          // reset to zero just for biasing (this option can be evtl enabled in a future...) 
          //double vmin;vmin=-smallgrid.getMinValue()+1;
@@ -943,7 +1332,7 @@ double Grid::integrate( std::vector<unsigned>& npoints ){
 }
 
 void Grid::mpiSumValuesAndDerivatives( Communicator& comm ){
-  comm.Sum( grid_ ); for(unsigned i=0;i<der_.size();++i) comm.Sum( der_[i] );
+  comm.Sum( grid_ );
 }
 
 }
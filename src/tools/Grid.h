@@ -78,8 +78,13 @@ public:
 // typedef unsigned index_t;
 private:
  double contour_location;
+/// values on the grid points; when derivatives are stored each value is followed by its gradient
  std::vector<double> grid_;
- std::vector< std::vector<double> > der_;
+/// spline interpolation without temporary vectors, for grids with up to four dimensions
+ template<unsigned dim>
+ double getSplineValueAndDerivatives(const std::vector<double> & x, double* der) const;
+/// read a grid written with writeToBinaryFile()
+ static Grid* createFromBinary(const std::string&,const std::vector<Value*>&,const std::string&,bool,bool,bool);
 protected:
  std::string funcname;
  std::vector<std::string> argnames;
@@ -90,9 +95,14 @@ protected:
  index_t maxsize_;
  unsigned dimension_;
  bool dospline_, usederiv_;
+ unsigned stride_; // number of doubles stored for each point
  std::string fmt_; // format for output 
  /// get "neighbors" for spline
  std::vector<index_t> getSplineNeighbors(const std::vector<unsigned> & indices)const;
+ /// get a pointer to the value of a point followed by its derivatives, NULL if it is not stored
+ virtual const double* getValueAndDerivativesPointer(index_t index) const;
+ /// write the header of a binary grid file containing npoints points
+ void writeBinaryHeader(OFile& ofile, index_t npoints);
 
 
 public:
@@ -125,6 +135,8 @@ public:
  std::vector<bool> getIsPeriodic() const;
 /// get grid dimension
  unsigned getDimension() const;
+/// get if derivatives are stored
+ bool hasDerivatives() const;
 /// get argument names  of this grid 
  std::vector<std::string> getArgNames() const;
  
@@ -199,6 +211,14 @@ public:
 
 /// dump grid on file
  virtual void writeToFile(OFile&);
+/// dump grid on file in binary format
+ virtual void writeToBinaryFile(OFile&);
+/// write the values stored on the grid in a binary checkpoint
+ virtual void writeBinary(std::ostream&)const;
+/// read the values written by writeBinary() on a grid with the same geometry
+ virtual void readBinary(std::istream&);
+/// check if a file contains a grid in binary format
+ static bool isBinaryFile(const std::string& path);
 /// dump grid to gaussian cube file
  void writeCubeFile(OFile&, const double& lunit);
 
@@ -220,17 +240,38 @@ public:
 class SparseGrid : public Grid
 {
 
- std::map<index_t,double> map_;
- std::map< index_t,std::vector<double> > der_;
+/// Points are allocated in tiles of consecutive indexes when they are first touched.
+/// Tiles are found through an open addressing hash table keyed by index/tileSize_.
+ static const unsigned tileSize_=32;
+/// value followed by the derivatives, if any, for each point of the allocated tiles
+ std::vector<double> tiles_;
+/// whether each point of the allocated tiles has been set
+ std::vector<char> stored_;
+/// tile numbers (or an empty marker) and their position in tiles_
+ std::vector<index_t> hashKeys_;
+ std::vector<unsigned> hashTiles_;
+/// number of allocated tiles and of points that have been set
+ unsigned ntiles_;
+ index_t npoints_;
+/// last tile touched, since points are usually updated in index order
+ index_t lastTile_;
+ unsigned lastTilePos_;
+/// position of a tile in tiles_, or ntiles_ if the tile is not allocated
+ unsigned findTile(index_t tile) const;
+/// pointer to the data of a point, allocating its tile and marking it as set
+ double* touchPoint(index_t index);
+/// indexes of the points that have been set, in increasing order
+ std::vector<index_t> getStoredPoints() const;
  
  protected:
  void clear(); 
+ const double* getValueAndDerivativesPointer(index_t index) const;
  
  public:
  SparseGrid(const std::string& funcl, const std::vector<Value*> & args, const std::vector<std::string> & gmin, 
             const std::vector<std::string> & gmax, 
             const std::vector<unsigned> & nbin, bool dospline, bool usederiv):
-            Grid(funcl,args,gmin,gmax,nbin,dospline,usederiv,false){}
+            Grid(funcl,args,gmin,gmax,nbin,dospline,usederiv,false),ntiles_(0),npoints_(0),lastTile_(~index_t(0)),lastTilePos_(0){}
  
  index_t getSize() const;
  index_t getMaxSize() const;
@@ -259,6 +300,12 @@ class SparseGrid : public Grid
 
 /// dump grid on file
  void writeToFile(OFile&);
+/// dump grid on file in binary format
+ void writeToBinaryFile(OFile&);
+/// write the stored points in a binary checkpoint
+ void writeBinary(std::ostream&)const;
+/// read the stored points written by writeBinary()
+ void readBinary(std::istream&);
 
  virtual ~SparseGrid(){}
 };
@@ -28,6 +28,10 @@
 #include "Tools.h"
 #include <cstdarg>
 #include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <clocale>
+#include <cstdint>
 
 #include <iostream>
 #include <string>
@@ -57,50 +61,178 @@ size_t IFile::llread(char*ptr,size_t s){
   return r;
 }
 
+/// Exact powers of ten, up to the largest one that can be represented exactly as a double
+static const double exactPowersOfTen[]={
+  1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9,1e10,1e11,
+  1e12,1e13,1e14,1e15,1e16,1e17,1e18,1e19,1e20,1e21,1e22
+};
+
+static inline bool isDigit(char c){
+  return c>='0' && c<='9';
+}
+
+/// Convert the number in [p,end) to a double without going through a stream.
+/// Only plain decimal numbers (optional sign, digits with an optional point and
+/// an optional exponent) are converted, and only when the result is guaranteed to be
+/// identical to the one of Tools::convert. It returns false in all other cases.
+static bool fastConvert(const char*p,const char*end,double&x){
+  const char* begin=p;
+  bool negative=false;
+  if(p<end && (*p=='+' || *p=='-')) negative=(*(p++)=='-');
+  uint64_t mantissa=0;
+  int ndigits=0,exponent=0;
+  bool found=false;
+  for(;p<end && isDigit(*p);++p){
+    found=true;
+    if(mantissa==0 && *p=='0') continue;
+    if(++ndigits>19) return false;
+    mantissa=10*mantissa+(*p-'0');
+  }
+  if(p<end && *p=='.'){
+    for(++p;p<end && isDigit(*p);++p){
+      found=true;
+      exponent--;
+      if(mantissa==0 && *p=='0') continue;
+      if(++ndigits>19) return false;
+      mantissa=10*mantissa+(*p-'0');
+    }
+  }
+  if(!found) return false;
+  if(p<end && (*p=='e' || *p=='E')){
+    ++p;
+    bool negexp=false;
+    if(p<end && (*p=='+' || *p=='-')) negexp=(*(p++)=='-');
+    if(p==end || !isDigit(*p)) return false;
+    int e=0;
+    for(;p<end && isDigit(*p);++p) if(e<10000) e=10*e+(*p-'0');
+    exponent+=(negexp?-e:e);
+  }
+  if(p!=end) return false;
+  if(mantissa==0){
+    x=(negative?-0.0:0.0);
+    return true;
+  }
+// mantissa and power of ten are exact, so the result is correctly rounded
+  if(mantissa<=(uint64_t(1)<<53) && exponent>=-22 && exponent<=22){
+    double d=double(mantissa);
+    if(exponent<0) d/=exactPowersOfTen[-exponent];
+    else d*=exactPowersOfTen[exponent];
+    x=(negative?-d:d);
+    return true;
+  }
+// otherwise strtod gives the same result as streams, provided that
+// the decimal point is a dot and that there is no overflow or underflow
+  if(*std::localeconv()->decimal_point!='.') return false;
+  char* last;
+  errno=0;
+  double d=std::strtod(begin,&last);
+  if(last!=end || errno==ERANGE) return false;
+  x=d;
+  return true;
+}
+
+/// Same as fastConvert(), for integers
+static bool fastConvert(const char*p,const char*end,int&x){
+  bool negative=false;
+  if(p<end && (*p=='+' || *p=='-')) negative=(*(p++)=='-');
+// up to nine digits there cannot be overflows
+  if(p==end || end-p>9) return false;
+  int n=0;
+  for(;p<end;++p){
+    if(!isDigit(*p)) return false;
+    n=10*n+(*p-'0');
+  }
+  x=(negative?-n:n);
+  return true;
+}
+
+void IFile::splitLine(){
+  words.clear();
+  if(line.find_first_of("{}")==std::string::npos){
+    const char* s=line.c_str();
+    unsigned n=line.length();
+    for(unsigned i=0;i<n;){
+      while(i<n && (s[i]==' ' || s[i]=='\t' || s[i]=='\n')) i++;
+      if(i==n) break;
+      words.push_back(i);
+      while(i<n && s[i]!=' ' && s[i]!='\t' && s[i]!='\n') i++;
+      words.push_back(i);
+    }
+  } else {
+// words within braces can contain spaces, so the line is split with getWords
+// and written again with a single space between words
+    std::vector<std::string> w=Tools::getWords(line);
+    line.clear();
+    for(unsigned i=0;i<w.size();i++){
+      words.push_back(line.length());
+      line+=w[i];
+      words.push_back(line.length());
+      line+=" ";
+    }
+  }
+}
+
 IFile& IFile::advanceField(){
   plumed_assert(!inMiddleOfField);
-  std::string line;
   bool done=false;
   while(!done){
     getline(line);
     if(!*this){return *this;}
-    std::vector<std::string> words=Tools::getWords(line);
-    if(words.size()>=2 && words[0]=="#!" && words[1]=="FIELDS"){
-      fields.clear();
-      for(unsigned i=2;i<words.size();i++){
+    size_t first=line.find_first_not_of(" \t\n");
+    bool header=(first!=std::string::npos && line.compare(first,2,"#!")==0 &&
+                 (first+2==line.length() || line[first+2]==' ' || line[first+2]=='\t' || line[first+2]=='\n'));
+    if(header){
+      std::vector<std::string> words=Tools::getWords(line);
+      if(words.size()>=2 && words[0]=="#!" && words[1]=="FIELDS"){
+        fields.clear();
+        for(unsigned i=2;i<words.size();i++){
+          Field field;
+          field.name=words[i];
+          fields.push_back(field);
+        }
+        continue;
+      } else if(words.size()==4 && words[0]=="#!" && words[1]=="SET"){
         Field field;
-        field.name=words[i];
+        field.name=words[2];
+        field.value=words[3];
+        field.constant=true;
         fields.push_back(field);
+        continue;
       }
-    } else if(words.size()==4 && words[0]=="#!" && words[1]=="SET"){
-      Field field;
-      field.name=words[2];
-      field.value=words[3];
-      field.constant=true;
-      fields.push_back(field);
-    } else {
-      unsigned nf=0;
-      for(unsigned i=0;i<fields.size();i++) if(!fields[i].constant) nf++;
-      Tools::trimComments(line);
-      words=Tools::getWords(line);
-      if( words.size()==nf ){
-          unsigned j=0;
-          for(unsigned i=0;i<fields.size();i++){
-            if(fields[i].constant) continue;
-            fields[i].value=words[j];
-            fields[i].read=false;
-            j++;
-          }
-          done=true;
-      } else if( !words.empty() ) {
-          plumed_merror(getPath() + " mismatch between number of fields in file and expected number");
-      }
+    }
+    unsigned nf=0;
+    for(unsigned i=0;i<fields.size();i++) if(!fields[i].constant) nf++;
+    size_t comment=line.find('#');
+    if(comment!=std::string::npos) line.erase(comment);
+    splitLine();
+    if( words.size()==2*nf ){
+        unsigned j=0;
+        for(unsigned i=0;i<fields.size();i++){
+          if(fields[i].constant) continue;
+          fields[i].begin=words[2*j];
+          fields[i].length=words[2*j+1]-words[2*j];
+          fields[i].read=false;
+          j++;
+        }
+        done=true;
+    } else if( !words.empty() ) {
+        plumed_merror(getPath() + " mismatch between number of fields in file and expected number");
     }
   }
   inMiddleOfField=true;
+  nextField=0;
   return *this;
 }
 
+const char* IFile::fieldValue(unsigned i,unsigned & length)const{
+  if(fields[i].constant){
+    length=fields[i].value.length();
+    return fields[i].value.c_str();
+  }
+  length=fields[i].length;
+  return line.c_str()+fields[i].begin;
+}
+
 IFile& IFile::open(const std::string&path){
   plumed_massert(!cloned,"file "+path+" appears to be cloned");
   eof=false;
@@ -142,22 +274,32 @@ IFile& IFile::scanField(const std::string&name,std::string&str){
   if(!inMiddleOfField) advanceField();
   if(!*this) return *this;
   unsigned i=findField(name);
-  str=fields[i].value;
+  unsigned length;
+  const char* p=fieldValue(i,length);
+  str.assign(p,length);
   fields[i].read=true;
   return *this;
 }
 
 IFile& IFile::scanField(const std::string&name,double &x){
-  std::string str;
-  scanField(name,str);
-  if(*this) Tools::convert(str,x);
+  if(!inMiddleOfField) advanceField();
+  if(!*this) return *this;
+  unsigned i=findField(name);
+  unsigned length;
+  const char* p=fieldValue(i,length);
+  if(!fastConvert(p,p+length,x)) Tools::convert(std::string(p,length),x);
+  fields[i].read=true;
   return *this;
 }
 
 IFile& IFile::scanField(const std::string&name,int &x){
-  std::string str;
-  scanField(name,str);
-  if(*this) Tools::convert(str,x);
+  if(!inMiddleOfField) advanceField();
+  if(!*this) return *this;
+  unsigned i=findField(name);
+  unsigned length;
+  const char* p=fieldValue(i,length);
+  if(!fastConvert(p,p+length,x)) Tools::convert(std::string(p,length),x);
+  fields[i].read=true;
   return *this;
 }
 
@@ -186,6 +328,7 @@ IFile& IFile::scanField(){
 }
 
 IFile::IFile():
+  nextField(0),
   inMiddleOfField(false),
   ignoreFields(false),
   noEOL(false)
@@ -198,11 +341,26 @@ IFile::~IFile(){
 
 IFile& IFile::getline(std::string &str){
   char tmp=0;
-  str="";
+  str.clear();
   fpos_t pos;
   fgetpos(fp,&pos);
-  while(llread(&tmp,1)==1 && tmp && tmp!='\n' && tmp!='\r' && !eof && !err){
-    str+=tmp;
+  if(gzfp){
+    while(llread(&tmp,1)==1 && tmp && tmp!='\n' && tmp!='\r' && !eof && !err){
+      str+=tmp;
+    }
+  } else {
+// same as above, reading characters with getc, which is much faster than fread
+    while(true){
+      int c=std::getc(fp);
+      if(c==EOF){
+        if(std::feof(fp)) eof=true;
+        if(std::ferror(fp)) err=true;
+        break;
+      }
+      tmp=c;
+      if(!tmp || tmp=='\n' || tmp=='\r' || eof || err) break;
+      str+=tmp;
+    }
   }
   if(tmp=='\r'){
     llread(&tmp,1);
@@ -225,10 +383,12 @@ IFile& IFile::getline(std::string &str){
   return *this;
 }
 
-unsigned IFile::findField(const std::string&name)const{
-  unsigned i;
-  for(i=0;i<fields.size();i++) if(fields[i].name==name) break;
+unsigned IFile::findField(const std::string&name){
+  unsigned i=nextField;
+  if(i>=fields.size() || fields[i].name!=name)
+    for(i=0;i<fields.size();i++) if(fields[i].name==name) break;
   if(i>=fields.size()) plumed_merror(name);
+  nextField=i+1;
   return i;
 }
 
@@ -44,13 +44,26 @@ public virtual FileBase{
   public FieldBase{
   public:
     bool read;
-    Field(): read(false) {}
+/// Position of the value of non-constant fields in IFile::line
+    unsigned begin;
+    unsigned length;
+    Field(): read(false), begin(0), length(0) {}
   };
 /// Low-level read.
 /// Note: in parallel, all processes read
   size_t llread(char*,size_t);
 /// All the defined fields
   std::vector<Field> fields;
+/// Last line read by advanceField().
+/// Values of non-constant fields are stored as positions in this string
+  std::string line;
+/// Begin and end of the words found in line, reused to avoid allocations
+  std::vector<unsigned> words;
+/// Index of the field following the last one that has been read.
+/// Fields are usually read in order, so it is the first one to be checked by findField()
+  unsigned nextField;
+/// Pointer to the value of field i and its length
+  const char* fieldValue(unsigned i,unsigned & length)const;
 /// Flag set in the middle of a field reading
   bool inMiddleOfField;
 /// Set to true if you want to allow fields to be ignored in the read in file
@@ -59,8 +72,10 @@ public virtual FileBase{
   bool noEOL;
 /// Advance to next field (= read one line)
   IFile& advanceField();
+/// Split line in words, storing their positions in words
+  void splitLine();
 /// Find field index by name
-  unsigned findField(const std::string&name)const;
+  unsigned findField(const std::string&name);
 public:
 /// Constructor
   IFile();
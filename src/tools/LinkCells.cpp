@@ -22,6 +22,7 @@
 #include "LinkCells.h"
 #include "Communicator.h"
 #include "Tools.h"
+#include <algorithm>
 
 namespace PLMD{
 
@@ -29,13 +30,14 @@ LinkCells::LinkCells( Communicator& cc ) :
 comm(cc),
 cutoffwasset(false),
 link_cutoff(0.0),
+built(false),
 ncells(3),
 nstride(3)
 {
 }
 
 void LinkCells::setCutoff( const double& lcut ){
-  cutoffwasset=true; link_cutoff=lcut;
+  cutoffwasset=true; link_cutoff=lcut; built=false;
 }
 
 double LinkCells::getCutoff() const {
@@ -47,8 +49,23 @@ void LinkCells::buildCellLists( const std::vector<Vector>& pos, const std::vecto
 
   // Must be able to check that pbcs are not nonsensical in some way?? -- GAT
 
+  // If the box and the atoms are the same as in the previous call the cells can be reused
+  const Tensor box( pbc.getBox() );
+  bool samebox=built;
+  for(unsigned i=0;i<3 && samebox;++i) for(unsigned j=0;j<3;++j) if( box(i,j)!=lastbox(i,j) ) samebox=false;
+  if( samebox && indices==lastindices ){
+      // Only the atoms that moved to a different cell require the lists to be rebuilt
+      bool moved=false;
+      for(unsigned i=0;i<pos.size();++i){
+          unsigned mycell=findCell( pos[i] );
+          if( mycell!=allcells[i] ){ allcells[i]=mycell; moved=true; }
+      }
+      if( moved ) sortAtomsInCells( indices );
+      return;
+  }
+
   // Setup the pbc object by copying it from action
-  mypbc.setBox( pbc.getBox() );
+  mypbc.setBox( box ); lastbox=box; lastindices=indices; built=true;
 
   // Setup the lists
   if( pos.size()!=allcells.size() ){ 
@@ -75,27 +92,26 @@ void LinkCells::buildCellLists( const std::vector<Vector>& pos, const std::vecto
   if( lcell_tots.size()!=ncellstot ){
       lcell_tots.resize( ncellstot ); lcell_starts.resize( ncellstot );
   }
-  // Clear nlcells
-  for(unsigned i=0;i<ncellstot;++i) lcell_tots[i]=0;
-  // Clear allcells
-  allcells.assign( allcells.size(), 0 );
-
-  // Find out what cell everyone is in
-  unsigned rank=comm.Get_rank(), size=comm.Get_size();
-  for(unsigned i=rank;i<pos.size();i+=size){
-      allcells[i]=findCell( pos[i] );
-      lcell_tots[allcells[i]]++;
-  }
-  // And gather all this information on every node
-  comm.Sum( allcells ); comm.Sum( lcell_tots );
+
+  // Find out what cell everyone is in. All the positions are available on every
+  // node, so this is cheaper than splitting the atoms and gathering the cells
+  for(unsigned i=0;i<pos.size();++i) allcells[i]=findCell( pos[i] );
 
   // Now prepare the link cell lists
+  sortAtomsInCells( indices );
+}
+
+void LinkCells::sortAtomsInCells( const std::vector<unsigned>& indices ){
+  // Count the atoms in each cell
+  for(unsigned i=0;i<lcell_tots.size();++i) lcell_tots[i]=0;
+  for(unsigned j=0;j<allcells.size();++j) lcell_tots[allcells[j]]++;
+
   unsigned tot=0;
   for(unsigned i=0;i<lcell_tots.size();++i){ lcell_starts[i]=tot; tot+=lcell_tots[i]; lcell_tots[i]=0; }
-  plumed_assert( tot==pos.size() );
+  plumed_assert( tot==allcells.size() );
 
   // And setup the link cells properly
-  for(unsigned j=0;j<pos.size();++j){
+  for(unsigned j=0;j<allcells.size();++j){
       unsigned myind = lcell_starts[ allcells[j] ] + lcell_tots[ allcells[j] ];
       lcell_lists[ myind ] = indices[j];
       lcell_tots[allcells[j]]++;
@@ -106,10 +122,10 @@ void LinkCells::buildCellLists( const std::vector<Vector>& pos, const std::vecto
 #define LINKC_MAX(n) ((n<3)? 1 : 2)
 #define LINKC_PBC(n,num) ((n<0)? num-1 : n%num )
 
-void LinkCells::retrieveNeighboringAtoms( const Vector& pos, unsigned& natomsper, std::vector<unsigned>& atoms ) const {
-  plumed_assert( natomsper==1 || natomsper==2 );  // This is really a bug. If you are trying to reuse this ask GAT for help
-  std::vector<unsigned> celn( findMyCell( pos ) );
+unsigned LinkCells::findNeighboringCells( const Vector& pos, unsigned* cells ) const {
+  unsigned celn[3]; findMyCell( pos, celn );
 
+  unsigned ncells_found=0;
   for(int nx=LINKC_MIN(ncells[0]);nx<LINKC_MAX(ncells[0]);++nx){
      int xval = celn[0] + nx;  
      xval=LINKC_PBC(xval,ncells[0])*nstride[0]; 
@@ -119,31 +135,56 @@ void LinkCells::retrieveNeighboringAtoms( const Vector& pos, unsigned& natomsper
          for(int nz=LINKC_MIN(ncells[2]);nz<LINKC_MAX(ncells[2]);++nz){
              int zval = celn[2] + nz;
              zval=LINKC_PBC(zval,ncells[2])*nstride[2]; 
-
-             unsigned mybox=xval+yval+zval;
-             for(unsigned k=0;k<lcell_tots[mybox];++k){
-                 unsigned myatom = lcell_lists[lcell_starts[mybox]+k];
-                 if( myatom!=atoms[0] ){  // Ideally would provide an option to not do this
-                     atoms[natomsper]=myatom;
-                     natomsper++;
-                 } 
-             }
+             cells[ncells_found]=xval+yval+zval; ncells_found++;
          }
      }
   }
+  // Cells are visited in the order in which they are stored, so that the atoms of
+  // consecutive cells are read from a single contiguous block of lcell_lists
+  std::sort( cells, cells+ncells_found );
+  return ncells_found;
+}
+
+void LinkCells::retrieveNeighboringAtoms( const Vector& pos, unsigned& natomsper, std::vector<unsigned>& atoms ) const {
+  plumed_assert( natomsper==1 || natomsper==2 );  // This is really a bug. If you are trying to reuse this ask GAT for help
+  unsigned cells[27]; const unsigned ncells_found=findNeighboringCells( pos, cells );
+
+  const unsigned first=atoms[0];
+  for(unsigned i=0;i<ncells_found;){
+      // Find the last cell of this run of consecutive cells
+      unsigned j=i;
+      while( j+1<ncells_found && cells[j+1]==cells[j]+1 ) j++;
+      const unsigned kend=lcell_starts[cells[j]]+lcell_tots[cells[j]];
+      for(unsigned k=lcell_starts[cells[i]];k<kend;++k){
+          const unsigned myatom = lcell_lists[k];
+          if( myatom!=first ){  // Ideally would provide an option to not do this
+              atoms[natomsper]=myatom;
+              natomsper++;
+          } 
+      }
+      i=j+1;
+  }
+}
+
+void LinkCells::retrieveAtomsInSurroundingCells( const Vector& pos, std::vector<unsigned>& atoms ) const {
+  unsigned cells[27]; const unsigned ncells_found=findNeighboringCells( pos, cells ); atoms.resize(0);
+
+  for(unsigned i=0;i<ncells_found;++i){
+      const unsigned mybox=cells[i];
+      atoms.insert( atoms.end(), lcell_lists.begin()+lcell_starts[mybox], lcell_lists.begin()+lcell_starts[mybox]+lcell_tots[mybox] );
+  }
 }
 
-std::vector<unsigned> LinkCells::findMyCell( const Vector& pos ) const {
-  Vector fpos=mypbc.realToScaled( pos ); std::vector<unsigned> celn(3);
+void LinkCells::findMyCell( const Vector& pos, unsigned* celn ) const {
+  Vector fpos=mypbc.realToScaled( pos );
   for(unsigned j=0;j<3;++j){
      celn[j] = std::floor( ( Tools::pbc(fpos[j]) + 0.5 ) * ncells[j] );
      plumed_assert( celn[j]>=0 && celn[j]<ncells[j] ); // Check that atom is in box  
   }
-  return celn;
 }
 
 unsigned LinkCells::findCell( const Vector& pos ) const {
-  std::vector<unsigned> celn( findMyCell(pos ) );
+  unsigned celn[3]; findMyCell( pos, celn );
   return celn[0]*nstride[0] + celn[1]*nstride[1] + celn[2]*nstride[2];
 }
 
@@ -24,6 +24,7 @@
 
 #include <vector>
 #include "Vector.h"
+#include "Tensor.h"
 #include "Pbc.h"
 
 namespace PLMD{
@@ -31,7 +32,9 @@ namespace PLMD{
 class Communicator;
 
 /// \ingroup TOOLBOX
-/// A class for doing link cells
+/// A class for doing link cells.
+/// The cells are kept between calls to buildCellLists(), so that when the box and the
+/// list of atoms do not change the lists are only rebuilt if some atom has moved to a different cell.
 class LinkCells {
 private:
 /// Symbolic link to plumed communicator
@@ -42,6 +45,12 @@ private:
   double link_cutoff;
 /// The pbc we are using for link cells
   Pbc mypbc;
+/// Have the lists been built at least once
+  bool built;
+/// The box used when the lists were last built
+  Tensor lastbox;
+/// The indices of the atoms when the lists were last built
+  std::vector<unsigned> lastindices;
 /// The number of cells in each direction
   std::vector<unsigned> ncells;
 /// The number of cells to stride through to get the link cells
@@ -55,9 +64,13 @@ private:
 /// The atoms ordered by link cells
   std::vector<unsigned> lcell_lists;
 /// Find the cell in which this position is contained
-  std::vector<unsigned> findMyCell( const Vector& pos ) const ;
+  void findMyCell( const Vector& pos, unsigned* celn ) const ;
 /// Find the cell in which this position is contained
   unsigned findCell( const Vector& pos ) const ;
+/// Get the cell containing pos and the cells that surround it, sorted, and return how many they are
+  unsigned findNeighboringCells( const Vector& pos, unsigned* cells ) const ;
+/// Sort the atoms in lcell_lists according to the cells in allcells
+  void sortAtomsInCells( const std::vector<unsigned>& indices );
 public:
 ///
   explicit LinkCells( Communicator& comm );
@@ -69,8 +82,11 @@ public:
   double getCutoff() const ;
 /// Build the link cell lists
   void buildCellLists( const std::vector<Vector>& pos, const std::vector<unsigned>& indices, const Pbc& pbc );
-/// Find a list of relevant atoms
+/// Find a list of relevant atoms. Atoms are returned in order of cell, with the atoms of each cell
+/// in the order in which they were passed to buildCellLists()
   void retrieveNeighboringAtoms( const Vector& pos, unsigned& natomsper, std::vector<unsigned>& atoms ) const ; 
+/// Get all the atoms in the cell containing pos and in the cells that surround it
+  void retrieveAtomsInSurroundingCells( const Vector& pos, std::vector<unsigned>& atoms ) const ;
 };
 
 inline
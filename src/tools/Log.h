@@ -35,6 +35,10 @@ namespace PLMD{
 class Log :
   public OFile
 {
+public:
+/// The log is always written synchronously, so that it is complete
+/// also when PLUMED stops with an error
+  Log(){ setAsync(0); }
 };
 
 }
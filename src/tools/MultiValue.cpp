@@ -20,57 +20,84 @@
    along with plumed.  If not, see <http://www.gnu.org/licenses/>.
 +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 #include "MultiValue.h"
+#include "Tools.h"
+#include <algorithm>
 
 namespace PLMD{
 
+/// Number of slots for which memory is reserved at construction
+static const unsigned initialSlots=64;
+
+const unsigned MultiValue::noslot;
+
 MultiValue::MultiValue( const unsigned& nvals, const unsigned& nder ):
+slot(nder,noslot),
+activeUpdated(false),
 values(nvals),
 nderivatives(nder),
-derivatives(nvals*nder),
 tmpval(0),
-tmpder(nder),
 atLeastOneSet(false)
 {
-  std::vector<unsigned> myind( nder );
-  for(unsigned i=0;i<nder;++i) myind[i]=i;
-  hasDerivatives.createIndexListFromVector( myind ); 
+  const unsigned nslots=std::min(nder,initialSlots);
+  slotIndex.reserve(nslots); active.reserve(nslots);
+  derivatives.reserve(nslots*nvals); tmpder.reserve(nslots);
 }
 
 void MultiValue::resize( const unsigned& nvals, const unsigned& nder ){
-  values.resize(nvals); nderivatives=nder; derivatives.resize( nvals*nder );
-  tmpder.resize( nder ); hasDerivatives.clear(); std::vector<unsigned> myind( nder ); 
-  for(unsigned i=0;i<nder;++i) myind[i]=i;
-  hasDerivatives.createIndexListFromVector( myind );
-  atLeastOneSet=false;
+  values.resize(nvals); nderivatives=nder; 
+  slot.assign(nder,noslot); slotIndex.clear(); active.clear();
+  derivatives.clear(); tmpder.clear(); tmpval=0;
+  activeUpdated=false; atLeastOneSet=false;
+}
+
+unsigned MultiValue::addSlot( const unsigned& jder ){
+  const unsigned k=slotIndex.size(), nvals=values.size();
+  slot[jder]=k; slotIndex.push_back(jder);
+  derivatives.resize( nvals*(k+1), 0.0 );
+  tmpder.push_back(0.0);
+  return k;
+}
+
+void MultiValue::updateActiveMembers(){
+  active.assign( slotIndex.begin(), slotIndex.end() );
+  std::sort( active.begin(), active.end() );
+  activeUpdated=true;
+}
+
+void MultiValue::sortActiveList(){
+  std::sort( active.begin(), active.end() );
+  activeUpdated=true;
 }
 
 void MultiValue::clearAll(){
-  if( atLeastOneSet && !hasDerivatives.updateComplete() ) hasDerivatives.updateActiveMembers();
-  for(unsigned i=0;i<values.size();++i) clear(i);
-  clearTemporyDerivatives(); hasDerivatives.deactivateAll(); atLeastOneSet=false;
+  for(unsigned i=0;i<values.size();++i) values[i]=0;
+  for(unsigned k=0;k<slotIndex.size();++k) slot[ slotIndex[k] ]=noslot;
+  slotIndex.clear(); active.clear(); derivatives.clear(); tmpder.clear(); tmpval=0.;
+  activeUpdated=false; atLeastOneSet=false;
 }
 
 void MultiValue::clear( const unsigned& ival ){
   values[ival]=0;
-  unsigned base=ival*nderivatives, ndert=hasDerivatives.getNumberActive();
-  for(unsigned i=0;i<ndert;++i) derivatives[ base+hasDerivatives[i] ]=0.;   
+  const unsigned nvals=values.size();
+  for(unsigned k=0;k<slotIndex.size();++k) derivatives[ nvals*k+ival ]=0.;   
 }
 
 void MultiValue::clearTemporyDerivatives(){
-  unsigned ndert=hasDerivatives.getNumberActive(); tmpval=0.;
-  for(unsigned i=0;i<ndert;++i) tmpder[ hasDerivatives[i] ]=0.;
+  tmpval=0.;
+  for(unsigned k=0;k<tmpder.size();++k) tmpder[k]=0.;
 }
 
 void MultiValue::chainRule( const unsigned& ival, const unsigned& iout, const unsigned& stride, const unsigned& off, 
                             const double& df, const unsigned& bufstart, std::vector<double>& buffer ){
-  if( !hasDerivatives.updateComplete() ) hasDerivatives.updateActiveMembers();
+  if( !activeUpdated ) updateActiveMembers();
 
   plumed_dbg_assert( off<stride );
-  unsigned base=nderivatives*ival, ndert=hasDerivatives.getNumberActive();
+  const unsigned nvals=values.size(), ndert=active.size();
   unsigned start=bufstart+stride*(nderivatives+1)*iout + stride; 
   for(unsigned i=0;i<ndert;++i){
-      unsigned jder=hasDerivatives[i];
-      buffer[start+jder*stride] += df*derivatives[base+jder];
+      const unsigned jder=active[i], k=slot[jder];
+      if( k==noslot ) continue;
+      buffer[start+jder*stride] += df*derivatives[nvals*k+ival];
   }
 }
 
@@ -82,37 +109,35 @@ void MultiValue::copyValues( MultiValue& outvals ) const {
 
 void MultiValue::copyDerivatives( MultiValue& outvals ){
   plumed_dbg_assert( values.size()<=outvals.getNumberOfValues() && nderivatives<=outvals.getNumberOfDerivatives() );
-  if( !hasDerivatives.updateComplete() ) hasDerivatives.updateActiveMembers();
+  if( !activeUpdated ) updateActiveMembers();
 
-  outvals.atLeastOneSet=true; unsigned ndert=hasDerivatives.getNumberActive();
+  outvals.atLeastOneSet=true; 
+  const unsigned nvals=values.size(), onvals=outvals.values.size(), ndert=active.size();
   for(unsigned j=0;j<ndert;++j){
-      unsigned jder=hasDerivatives[j]; outvals.hasDerivatives.activate(jder);
-  }
-  
-  unsigned base=0, obase=0;
-  for(unsigned i=0;i<values.size();++i){
-     for(unsigned j=0;j<ndert;++j){
-        unsigned jder=hasDerivatives[j];
-        outvals.derivatives[obase+jder] += derivatives[base+jder];
-     }
-     obase+=outvals.nderivatives; base+=nderivatives;
+      const unsigned jder=active[j], k=slot[jder];
+// derivatives in the active list that were not set are zero, but they are still activated in outvals
+      const unsigned ok=outvals.getSlot(jder);
+      if( k==noslot ) continue;
+      const double* from=&derivatives[nvals*k];
+      double* to=&outvals.derivatives[onvals*ok];
+      for(unsigned i=0;i<nvals;++i) to[i] += from[i];
   }
 }
 
 void MultiValue::quotientRule( const unsigned& nder, const unsigned& oder ){
   plumed_dbg_assert( nder<values.size() && oder<values.size() );
-  if( !hasDerivatives.updateComplete() ) hasDerivatives.updateActiveMembers();
+  if( !activeUpdated ) updateActiveMembers();
 
-  unsigned ndert=hasDerivatives.getNumberActive(); double wpref;
-  unsigned obase=oder*nderivatives, nbase=nder*nderivatives;
+  const unsigned nvals=values.size(), ndert=active.size(); double wpref;
 
   if( fabs(tmpval)>epsilon ){ wpref=1.0/tmpval; } 
   else{ wpref=1.0; }
 
   double pref = values[nder]*wpref*wpref;
   for(unsigned j=0;j<ndert;++j){
-      unsigned jder=hasDerivatives[j];
-      derivatives[obase+jder] = wpref*derivatives[nbase+jder]  - pref*tmpder[jder];
+      const unsigned k=slot[ active[j] ];
+      if( k==noslot ) continue;
+      derivatives[nvals*k+oder] = wpref*derivatives[nvals*k+nder]  - pref*tmpder[k];
   }
   values[oder] = wpref*values[nder];
 }
@@ -24,29 +24,60 @@
 
 #include <vector>
 #include "Exception.h"
-#include "DynamicList.h"
+#include "Vector.h"
 
 namespace PLMD{
 
+/**
+\ingroup TOOLBOX
+Class for storing a set of values and their derivatives.
+
+Derivatives are stored sparsely. Every derivative that is set is given a slot,
+and the derivatives of all the values with respect to that quantity are stored
+contiguously in the slot. Only the slots that were used are cleared, so the cost of
+clearAll() and of the loops over the derivatives depends on the number of derivatives
+that were set and not on the total number of derivatives. The only array whose size
+is proportional to the total number of derivatives contains the position of the slot
+of each derivative.
+
+The list of active derivatives that is returned by getActiveIndex() is the sorted list of the
+derivatives that were set, and is updated when needed. As in \ref DynamicList, it can
+also be constructed explicitly with emptyActiveMembers(), putIndexInActiveArray()
+and completeUpdate().
+*/
 class MultiValue {
 private:
-/// Used to ensure rapid accumulation of derivatives
-  DynamicList<unsigned> hasDerivatives;
+/// Used to mark the derivatives that have not been set
+  static const unsigned noslot=~0U;
+/// Position of the slot of each derivative, noslot if it has not been set
+  std::vector<unsigned> slot;
+/// The derivative stored in each slot
+  std::vector<unsigned> slotIndex;
+/// The list of active derivatives
+  std::vector<unsigned> active;
+/// Is the list of active derivatives up to date
+  bool activeUpdated;
 /// Values of quantities
   std::vector<double> values;
 /// Number of derivatives per value
   unsigned nderivatives;
-/// Derivatives
+/// Derivatives, the derivatives of all the values with respect to one quantity are contiguous
   std::vector<double> derivatives;
 /// Tempory value
   double tmpval;
-/// Tempory vector of derivatives (used for calculating quotients
+/// Tempory vector of derivatives (used for calculating quotients), one per slot
   std::vector<double> tmpder;
 /// Logical to check if any derivatives were set
   bool atLeastOneSet;
 /// This is a fudge to save on vector resizing in MultiColvar
   std::vector<unsigned> indices, sort_indices;
   std::vector<Vector> tmp_atoms;
+/// Get the slot of derivative jder, creating it if needed
+  unsigned getSlot( const unsigned& jder );
+/// Create a new slot for derivative jder
+  unsigned addSlot( const unsigned& jder );
+/// Make the list of active derivatives from the list of slots
+  void updateActiveMembers();
 public:
   MultiValue( const unsigned& , const unsigned& );
   void resize( const unsigned& , const unsigned& );
@@ -133,10 +164,18 @@ void MultiValue::addValue( const unsigned& ival,  const double& val){
   values[ival]+=val;
 }
 
+inline
+unsigned MultiValue::getSlot( const unsigned& jder ){
+  plumed_dbg_assert( jder<nderivatives );
+  unsigned k=slot[jder];
+  if( k==noslot ) k=addSlot( jder );
+  return k;
+}
+
 inline
 void MultiValue::addDerivative( const unsigned& ival, const unsigned& jder, const double& der){
   plumed_dbg_assert( ival<=values.size() && jder<nderivatives ); atLeastOneSet=true;
-  hasDerivatives.activate(jder); derivatives[nderivatives*ival+jder] += der;
+  derivatives[values.size()*getSlot(jder)+ival] += der;
 }
 
 inline
@@ -147,73 +186,73 @@ void MultiValue::addTemporyValue( const double& val ){
 inline
 void MultiValue::addTemporyDerivative( const unsigned& jder, const double& der ){
   plumed_dbg_assert( jder<nderivatives ); atLeastOneSet=true;
-  hasDerivatives.activate(jder); tmpder[jder] += der;
+  tmpder[getSlot(jder)] += der;
 }
 
 
 inline
 void MultiValue::setDerivative( const unsigned& ival, const unsigned& jder, const double& der){
   plumed_dbg_assert( ival<=values.size() && jder<nderivatives ); atLeastOneSet=true;
-  hasDerivatives.activate(jder); derivatives[nderivatives*ival+jder]=der;
+  derivatives[values.size()*getSlot(jder)+ival]=der;
 }
 
 
 inline
 double MultiValue::getDerivative( const unsigned& ival, const unsigned& jder ) const {
-  plumed_dbg_assert( jder<nderivatives && hasDerivatives.isActive(jder) );
-  return derivatives[nderivatives*ival+jder];
+  plumed_dbg_assert( jder<nderivatives );
+  const unsigned k=slot[jder];
+  if( k==noslot ) return 0.0;
+  return derivatives[values.size()*k+ival];
 }
 
 inline
 double MultiValue::getTemporyDerivative( const unsigned& jder ) const {
-  plumed_dbg_assert( jder<nderivatives && hasDerivatives.isActive(jder) );
-  return tmpder[jder];
+  plumed_dbg_assert( jder<nderivatives );
+  const unsigned k=slot[jder];
+  if( k==noslot ) return 0.0;
+  return tmpder[k];
 }
 
 inline
 bool MultiValue::updateComplete(){
-  return hasDerivatives.updateComplete();
+  return activeUpdated;
 }
 
 inline
 void MultiValue::emptyActiveMembers(){
-  hasDerivatives.emptyActiveMembers();
+  active.clear();
 }
 
 inline
 void MultiValue::putIndexInActiveArray( const unsigned& ind ){
-  hasDerivatives.putIndexInActiveArray( ind );
+  plumed_dbg_assert( ind<nderivatives );
+  active.push_back( ind );
 }
 
 inline
 void MultiValue::updateIndex( const unsigned& ind ){
-  if( hasDerivatives.isActive(ind) ) hasDerivatives.putIndexInActiveArray( ind );
-}
-
-inline
-void MultiValue::sortActiveList(){
-  hasDerivatives.sortActiveList();
+  if( isActive(ind) ) putIndexInActiveArray( ind );
 }
 
 inline
 void MultiValue::completeUpdate(){
-  hasDerivatives.completeUpdate();
+  activeUpdated=true;
 }
 
 inline
 unsigned MultiValue::getNumberActive() const {
-  return hasDerivatives.getNumberActive();
+  return active.size();
 }
 
 inline
 unsigned MultiValue::getActiveIndex( const unsigned& ind ) const {
-  plumed_dbg_assert( ind<hasDerivatives.getNumberActive() );
-  return hasDerivatives[ind];
+  plumed_dbg_assert( ind<active.size() );
+  return active[ind];
 }
 
 inline
 void MultiValue::updateDynamicList(){
-  if( atLeastOneSet ) hasDerivatives.updateActiveMembers();
+  if( atLeastOneSet ) updateActiveMembers();
 }
 
 inline
@@ -233,7 +272,8 @@ std::vector<Vector>& MultiValue::getAtomVector(){
 
 inline
 bool MultiValue::isActive( const unsigned& ind ) const {
-  return hasDerivatives.isActive( ind );
+  plumed_dbg_assert( ind<nderivatives );
+  return slot[ind]!=noslot;
 }
 
 }
@@ -24,6 +24,8 @@
 #include "Pbc.h"
 #include "AtomNumber.h"
 #include "Tools.h"
+#include "LinkCells.h"
+#include "Communicator.h"
 #include <vector>
 #include <algorithm>
 
@@ -34,7 +36,7 @@ NeighborList::NeighborList(const vector<AtomNumber>& list0, const vector<AtomNum
                            const bool& do_pair, const bool& do_pbc, const Pbc& pbc,
                            const double& distance, const unsigned& stride): reduced(false),
                            do_pair_(do_pair), do_pbc_(do_pbc), pbc_(&pbc),
-                           distance_(distance), stride_(stride)
+                           distance_(distance), skin_(0.0), stride_(stride)
 {
 // store full list of atoms needed
  fullatomlist_=list0;
@@ -55,8 +57,8 @@ NeighborList::NeighborList(const vector<AtomNumber>& list0, const vector<AtomNum
 NeighborList::NeighborList(const vector<AtomNumber>& list0, const bool& do_pbc,
                            const Pbc& pbc, const double& distance,
                            const unsigned& stride): reduced(false),
-                           do_pbc_(do_pbc), pbc_(&pbc),
-                           distance_(distance), stride_(stride){
+                           do_pair_(false), do_pbc_(do_pbc), pbc_(&pbc),
+                           distance_(distance), skin_(0.0), stride_(stride){
  fullatomlist_=list0;
  nlist0_=list0.size();
  twolists_=false;
@@ -93,25 +95,61 @@ pair<unsigned,unsigned> NeighborList::getIndexPair(unsigned ipair) {
 
 void NeighborList::update(const vector<Vector>& positions) {
  neighbors_.clear();
- const double d2=distance_*distance_;
 // check if positions array has the correct length 
  plumed_assert(positions.size()==fullatomlist_.size());
- for(unsigned int i=0;i<nallpairs_;++i){
-   pair<unsigned,unsigned> index=getIndexPair(i);
-   unsigned index0=index.first;
-   unsigned index1=index.second;
-   Vector distance;
-   if(do_pbc_){
-    distance=pbc_->distance(positions[index0],positions[index1]);
-   } else {
-    distance=delta(positions[index0],positions[index1]);
-   }
-   double value=modulo2(distance);
-   if(value<=d2) {neighbors_.push_back(index);} 
+// with pbc the candidate pairs can be found with link cells, so that the cost
+// of the update scales linearly with the number of atoms
+ if(do_pbc_ && pbc_->isSet() && !(twolists_ && do_pair_)) updateWithLinkCells(positions);
+ else {
+  for(unsigned int i=0;i<nallpairs_;++i){
+    pair<unsigned,unsigned> index=getIndexPair(i);
+    if(isClosePair(positions,index.first,index.second)) neighbors_.push_back(index);
+  }
+ }
+ if(skin_>0.0){
+  lastpositions_=positions;
+  if(do_pbc_) lastbox_=pbc_->getBox();
  }
  setRequestList();
 }
 
+void NeighborList::updateWithLinkCells(const vector<Vector>& positions) {
+// the link cells are built on the second list (or on the only list) and
+// every atom of the first list looks for its partners in the surrounding cells
+ unsigned first=twolists_?nlist0_:0;
+ vector<Vector> cellpos(positions.begin()+first,positions.end());
+ vector<unsigned> cellind(cellpos.size());
+ for(unsigned j=0;j<cellind.size();++j) cellind[j]=first+j;
+ Communicator serial;
+ LinkCells linkcells(serial);
+ linkcells.setCutoff(distance_);
+ linkcells.buildCellLists(cellpos,cellind,*pbc_);
+
+ vector<unsigned> candidates, partners;
+ for(unsigned i=0;i<nlist0_;++i){
+  linkcells.retrieveAtomsInSurroundingCells(positions[i],candidates);
+  partners.resize(0);
+  for(unsigned k=0;k<candidates.size();++k){
+    unsigned j=candidates[k];
+    if(!twolists_ && j<=i) continue;
+    if(isClosePair(positions,i,j)) partners.push_back(j);
+  }
+// sort so that pairs are in the same order as in the all-pairs search
+  std::sort(partners.begin(),partners.end());
+  for(unsigned k=0;k<partners.size();++k) neighbors_.push_back(pair<unsigned,unsigned>(i,partners[k]));
+ }
+}
+
+bool NeighborList::isClosePair(const vector<Vector>& positions,unsigned index0,unsigned index1) const {
+ Vector distance;
+ if(do_pbc_){
+  distance=pbc_->distance(positions[index0],positions[index1]);
+ } else {
+  distance=delta(positions[index0],positions[index1]);
+ }
+ return modulo2(distance)<=distance_*distance_;
+}
+
 void NeighborList::setRequestList() {
  requestlist_.clear();
  for(unsigned int i=0;i<size();++i){
@@ -140,6 +178,42 @@ unsigned NeighborList::getStride() const {
  return stride_;
 }
 
+void NeighborList::setSkin(const double& skin) {
+ plumed_assert(skin>=0.0 && skin<distance_);
+ skin_=skin;
+ lastpositions_.clear();
+}
+
+double NeighborList::getSkin() const {
+ return skin_;
+}
+
+bool NeighborList::isOutdated(const vector<Vector>& positions) const {
+ if(lastpositions_.size()!=positions.size()) return true;
+// a change of the box moves the periodic images by at most the sum of the
+// changes of the lattice vectors (assuming the cutoff is smaller than half the box)
+ double boxshift=0.0;
+ if(do_pbc_){
+  Tensor dbox=pbc_->getBox()-lastbox_;
+  for(unsigned i=0;i<3;++i) boxshift+=dbox.getRow(i).modulo();
+ }
+// two atoms moving towards each other by more than half of the remaining skin
+// might have entered the cutoff
+ const double maxdisp=0.5*(skin_-boxshift);
+ if(maxdisp<=0.0) return true;
+ const double maxdisp2=maxdisp*maxdisp;
+ for(unsigned int i=0;i<positions.size();++i){
+  Vector displacement;
+  if(do_pbc_){
+   displacement=pbc_->distance(lastpositions_[i],positions[i]);
+  } else {
+   displacement=delta(lastpositions_[i],positions[i]);
+  }
+  if(modulo2(displacement)>maxdisp2) return true;
+ }
+ return false;
+}
+
 unsigned NeighborList::getLastUpdate() const {
  return lastupdate_;
 }
@@ -23,6 +23,7 @@
 #define __PLUMED_tools_NeighborList_h
 
 #include "Vector.h"
+#include "Tensor.h"
 #include "AtomNumber.h"
 
 #include <vector>
@@ -40,8 +41,11 @@ class NeighborList
   const PLMD::Pbc* pbc_;
   std::vector<PLMD::AtomNumber> fullatomlist_,requestlist_;
   std::vector<std::pair<unsigned,unsigned> > neighbors_;
-  double distance_;
+  double distance_,skin_;
   unsigned stride_,nlist0_,nlist1_,nallpairs_,lastupdate_;
+/// Positions and box at the last update, used to decide when the list is outdated
+  std::vector<PLMD::Vector> lastpositions_;
+  PLMD::Tensor lastbox_;
 /// Initialize the neighbor list with all possible pairs
   void initialize();
 /// Return the pair of indexes in the positions array
@@ -49,6 +53,10 @@ class NeighborList
   std::pair<unsigned,unsigned> getIndexPair(unsigned i);
 /// Extract the list of atoms from the current list of close pairs
   void setRequestList();
+/// Find the close pairs using link cells rather than looping over all pairs
+  void updateWithLinkCells(const std::vector<PLMD::Vector>& positions);
+/// Check if the two atoms are closer than the cutoff
+  bool isClosePair(const std::vector<PLMD::Vector>& positions,unsigned index0,unsigned index1) const;
 public:
   NeighborList(const std::vector<PLMD::AtomNumber>& list0,
                const std::vector<PLMD::AtomNumber>& list1,
@@ -68,6 +76,14 @@ public:
   void update(const std::vector<PLMD::Vector>& positions);
 /// Get the update stride of the neighbor list
   unsigned getStride() const;
+/// Set the skin of the neighbor list. The list should then be updated
+/// only when isOutdated() returns true
+  void setSkin(const double& skin);
+/// Get the skin of the neighbor list
+  double getSkin() const;
+/// Check if the atoms moved so much since the last update that a pair
+/// closer than the cutoff minus the skin might be missing from the list
+  bool isOutdated(const std::vector<PLMD::Vector>& positions) const;
 /// Get the last step in which the neighbor list was updated  
   unsigned getLastUpdate() const;
 /// Set the step of the last update
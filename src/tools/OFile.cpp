@@ -28,6 +28,7 @@
 #include "Tools.h"
 #include <cstdarg>
 #include <cstring>
+#include <algorithm>
 
 #include <iostream>
 #include <string>
@@ -38,22 +39,150 @@
 #include <zlib.h>
 #endif
 
+#ifdef __PLUMED_HAS_THREADS
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+
 namespace PLMD{
 
+#ifdef __PLUMED_HAS_THREADS
+/// Ring buffer drained by a thread that writes its content on an OFile.
+/// write() only blocks when the buffer is full. To avoid waking up the thread
+/// for every line, data are written when the buffer is half full or when sync() is called.
+class OFile::AsyncWriter{
+  OFile& ofile;
+  std::vector<char> ring;
+/// amount of data that wakes up the thread
+  size_t threshold;
+/// position where the next byte is added
+  size_t head;
+/// position of the first byte that has not been written yet
+  size_t tail;
+/// number of bytes in the buffer, including those being written
+  size_t used;
+/// true while the thread is writing a chunk
+  bool busy;
+/// true while sync() waits for the buffer to be emptied
+  bool draining;
+/// true if a write failed since the last call to sync()
+  bool failed;
+  bool stop;
+  std::mutex mtx;
+  std::condition_variable dataReady;
+  std::condition_variable spaceReady;
+  std::thread thread;
+  void run();
+public:
+  AsyncWriter(OFile&,size_t);
+/// Write all the remaining data and stop the thread
+  ~AsyncWriter();
+/// Copy data in the buffer
+  void write(const char*,size_t);
+/// Wait until the buffer is empty. Returns false if some write failed
+  bool sync();
+};
+
+OFile::AsyncWriter::AsyncWriter(OFile&ofile,size_t size):
+  ofile(ofile),
+  ring(size),
+  threshold((size+1)/2),
+  head(0),
+  tail(0),
+  used(0),
+  busy(false),
+  draining(false),
+  failed(false),
+  stop(false)
+{
+  plumed_assert(size>0);
+  thread=std::thread(&AsyncWriter::run,this);
+}
+
+OFile::AsyncWriter::~AsyncWriter(){
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    stop=true;
+  }
+  dataReady.notify_one();
+  thread.join();
+}
+
+void OFile::AsyncWriter::write(const char*ptr,size_t n){
+  std::unique_lock<std::mutex> lock(mtx);
+  while(n>0){
+    spaceReady.wait(lock,[this]{return used<ring.size();});
+// contiguous free space starting from head
+    size_t chunk=std::min(n,std::min(ring.size()-used,ring.size()-head));
+    std::memcpy(&ring[head],ptr,chunk);
+    head=(head+chunk)%ring.size();
+    bool wake=(used<threshold && used+chunk>=threshold);
+    used+=chunk;
+    ptr+=chunk;
+    n-=chunk;
+    if(wake) dataReady.notify_one();
+  }
+}
+
+bool OFile::AsyncWriter::sync(){
+  std::unique_lock<std::mutex> lock(mtx);
+  draining=true;
+  dataReady.notify_one();
+  spaceReady.wait(lock,[this]{return used==0 && !busy;});
+  draining=false;
+  bool ok=!failed;
+  failed=false;
+  return ok;
+}
+
+void OFile::AsyncWriter::run(){
+  std::unique_lock<std::mutex> lock(mtx);
+  while(true){
+    dataReady.wait(lock,[this]{return used>=threshold || (used>0 && draining) || stop;});
+    if(used==0) break;
+// contiguous data starting from tail, written without holding the lock
+    size_t chunk=std::min(used,ring.size()-tail);
+    busy=true;
+    lock.unlock();
+    size_t r=ofile.rawwrite(&ring[tail],chunk);
+    lock.lock();
+    if(r!=chunk) failed=true;
+    tail=(tail+chunk)%ring.size();
+    used-=chunk;
+    busy=false;
+    spaceReady.notify_all();
+  }
+}
+#endif
+
+size_t OFile::rawwrite(const char*ptr,size_t s){
+  size_t r=0;
+  if(gzfp){
+#ifdef __PLUMED_HAS_ZLIB
+    r=gzwrite(gzFile(gzfp),ptr,s);
+#else
+    plumed_merror("trying to use a gz file without zlib being linked");
+#endif
+  } else {
+    r=fwrite(ptr,1,s,fp);
+  }
+  return r;
+}
+
 size_t OFile::llwrite(const char*ptr,size_t s){
   size_t r;
   if(linked) return linked->llwrite(ptr,s);
+  if(async){
+// data are written by the writer thread, errors are reported by syncAsync()
+#ifdef __PLUMED_HAS_THREADS
+    if(asyncWriter) asyncWriter->write(ptr,s);
+#endif
+    return s;
+  }
   if(! (comm && comm->Get_rank()>0)){
     if(!fp) plumed_merror("writing on uninitilized File");
-    if(gzfp){
-#ifdef __PLUMED_HAS_ZLIB
-      r=gzwrite(gzFile(gzfp),ptr,s);
-#else
-      plumed_merror("trying to use a gz file without zlib being linked");
-#endif
-    } else {
-      r=fwrite(ptr,1,s,fp);
-    }
+    r=rawwrite(ptr,s);
   }
 //  This barrier is apparently useless since it comes
 //  just before a Bcast.
@@ -70,12 +199,20 @@ size_t OFile::llwrite(const char*ptr,size_t s){
 
 OFile::OFile():
   linked(NULL),
+  asyncBufferSize(0),
+  async(false),
+  asyncWriter(NULL),
   fieldChanged(false),
   backstring("bck"),
   enforceRestart_(false),
   enforceBackup_(false)
 {
   fmtField();
+  if(std::getenv("PLUMED_ASYNC_OUTPUT")){
+    unsigned kb=0;
+    Tools::convert(std::getenv("PLUMED_ASYNC_OUTPUT"),kb);
+    asyncBufferSize=size_t(kb)*1024;
+  }
   buflen=1;
   actual_buffer_length=0;
   buffer=new char[buflen];
@@ -87,10 +224,39 @@ OFile::OFile():
 }
 
 OFile::~OFile(){
+#ifdef __PLUMED_HAS_THREADS
+// all the buffered data are written before the file is closed by FileBase
+  delete asyncWriter;
+#endif
   delete [] buffer_string;
   delete [] buffer;
 }
 
+OFile& OFile::setAsync(size_t bufferSize){
+  asyncBufferSize=bufferSize;
+  return *this;
+}
+
+void OFile::syncAsync(){
+  if(!async) return;
+  int ok=1;
+#ifdef __PLUMED_HAS_THREADS
+  if(asyncWriter && !asyncWriter->sync()) ok=0;
+#endif
+  if(comm) comm->Bcast(ok,0);
+  plumed_massert(ok,"error writing on file "+path);
+}
+
+void OFile::close(){
+  syncAsync();
+#ifdef __PLUMED_HAS_THREADS
+  delete asyncWriter;
+#endif
+  asyncWriter=NULL;
+  async=false;
+  FileBase::close();
+}
+
 OFile& OFile::link(OFile&l){
   fp=NULL;
   gzfp=NULL;
@@ -141,6 +307,13 @@ int OFile::printf(const char*fmt,...){
   return r;
 }
 
+OFile& OFile::write(const char*ptr,size_t n){
+  plumed_massert(actual_buffer_length==0,"unterminated line before binary output");
+  size_t r=llwrite(ptr,n);
+  plumed_massert(r==n,"error writing binary data on file "+path);
+  return *this;
+}
+
 OFile& OFile::addConstantField(const std::string&name){
   Field f;
   f.name=name;
@@ -317,6 +490,13 @@ OFile& OFile::open(const std::string&path){
 #endif
     }
   }
+#ifdef __PLUMED_HAS_THREADS
+  if(asyncBufferSize>0){
+    plumed_assert(!asyncWriter);
+    async=true;
+    if(!comm || comm->Get_rank()==0) asyncWriter=new AsyncWriter(*this,asyncBufferSize);
+  }
+#endif
   if(plumed) plumed->insertFile(*this);
   return *this;
 }
@@ -326,6 +506,7 @@ OFile& OFile::rewind(){
 // the reason is that normal rewind does not work when in append mode
 // moreover, we can take a backup of the file
   plumed_assert(fp);
+  syncAsync();
   clearFields();
   if(gzfp){
 #ifdef __PLUMED_HAS_ZLIB
@@ -350,6 +531,7 @@ OFile& OFile::rewind(){
 }
 
 FileBase& OFile::flush(){
+  syncAsync();
   if(heavyFlush){
     if(gzfp){
 #ifdef __PLUMED_HAS_ZLIB
@@ -163,6 +163,21 @@ public virtual FileBase{
   };
 /// Low-level write
   size_t llwrite(const char*,size_t);
+/// Write directly on the underlying file.
+/// Used by llwrite() and by the writer thread of asynchronous output
+  size_t rawwrite(const char*,size_t);
+/// Size of the buffer used for asynchronous output, zero for synchronous output
+  size_t asyncBufferSize;
+/// True if the file has been opened for asynchronous output.
+/// Set on all the processes, also on those that do not write
+  bool async;
+/// Thread writing buffered data on the file, see setAsync()
+  class AsyncWriter;
+/// Pointer to the writer thread. Only set on the process that actually writes
+  AsyncWriter* asyncWriter;
+/// Wait until all the data buffered for asynchronous output have been written.
+/// It should be called by all the processes
+  void syncAsync();
 /// True if fields has changed.
 /// This could be due to a change in the list of fields or a reset
 /// of a nominally constant field
@@ -215,6 +230,18 @@ public:
   void backupAllFiles( const std::string& str );
 /// Opens the file using automatic append/backup
   OFile& open(const std::string&name); 
+/// Closes the file, after all the buffered data have been written
+  void close();
+/** Set the size of the buffer used for asynchronous output.
+With a non-zero size, formatted data are copied in a buffer of this size and written
+on the file by a separate thread, so that the caller does not wait for the file system.
+flush(), rewind() and close() wait until all the data have been written and report
+write errors, thus keeping the same guarantees as synchronous output.
+Should be called before open(). The default is taken from the environment
+variable PLUMED_ASYNC_OUTPUT (in kilobytes) and is zero if it is not set.
+Ignored if PLUMED has been compiled without thread support.
+*/
+  OFile& setAsync(size_t bufferSize);
 /// Set the prefix for output.
 /// Typically "PLUMED: ". Notice that lines with a prefix cannot
 /// be parsed using fields in a IFile.
@@ -250,6 +277,9 @@ this method can be used to clean the field list.
   OFile& clearFields();
 /// Formatted output with explicit format - a la printf
   int printf(const char*fmt,...);
+/// Unformatted output of n bytes, e.g. for binary files.
+/// Text written with printf() should end with a newline before calling this.
+  OFile& write(const char*ptr,size_t n);
 /// Formatted output with << operator
   template <class T>
   friend OFile& operator<<(OFile&,const T &);
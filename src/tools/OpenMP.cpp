@@ -23,6 +23,9 @@
 #include "OpenMP.h"
 #include "Tools.h"
 #include <cstdlib>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace PLMD{
 
@@ -38,6 +41,22 @@ unsigned OpenMP::getNumThreads(){
   return numThreads;
 }
 
+unsigned OpenMP::getNumThreadsInTeam(){
+#ifdef _OPENMP
+  return omp_get_num_threads();
+#else
+  return 1;
+#endif
+}
+
+unsigned OpenMP::getThreadNum(){
+#ifdef _OPENMP
+  return omp_get_thread_num();
+#else
+  return 0;
+#endif
+}
+
 
 }
 
@@ -36,6 +36,12 @@ static unsigned getNumThreads();
 /// get cacheline size
 static unsigned getCachelineSize();
 
+/// Get the number of threads in the current team, 1 outside of parallel regions
+static unsigned getNumThreadsInTeam();
+
+/// Get the index of the calling thread in the current team, 0 outside of parallel regions
+static unsigned getThreadNum();
+
 /// Get a reasonable number of threads so as to access to an array of size s located at x
 template<typename T>
 static unsigned getGoodNumThreads(const T*x,unsigned s);
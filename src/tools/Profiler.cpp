@@ -0,0 +1,288 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2012-2017 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+#include "Profiler.h"
+#include "Exception.h"
+
+#include <cstdio>
+#include <cmath>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+
+#ifdef __PLUMED_HAS_PERF_EVENT
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace PLMD{
+
+#ifdef __PLUMED_HAS_PERF_EVENT
+/// Hardware counters that can be requested, with their perf_event configuration
+static const struct {const char* name; unsigned long long config;} perfCounters[]={
+  {"cycles",PERF_COUNT_HW_CPU_CYCLES},
+  {"instructions",PERF_COUNT_HW_INSTRUCTIONS},
+  {"cache-references",PERF_COUNT_HW_CACHE_REFERENCES},
+  {"cache-misses",PERF_COUNT_HW_CACHE_MISSES},
+  {"branch-instructions",PERF_COUNT_HW_BRANCH_INSTRUCTIONS},
+  {"branch-misses",PERF_COUNT_HW_BRANCH_MISSES}
+};
+#endif
+
+std::vector<std::string> Profiler::getAvailableCounters(){
+  std::vector<std::string> names;
+#ifdef __PLUMED_HAS_PERF_EVENT
+  for(const auto & c : perfCounters) names.push_back(c.name);
+#endif
+  return names;
+}
+
+Profiler::Profiler(const std::vector<std::string>&counters):
+  owner(std::this_thread::get_id())
+{
+  if(counters.size()==0) return;
+#ifdef __PLUMED_HAS_PERF_EVENT
+  for(const auto & name : counters){
+    int found=-1;
+    for(unsigned i=0;i<sizeof(perfCounters)/sizeof(perfCounters[0]);i++) if(name==perfCounters[i].name) found=i;
+    plumed_massert(found>=0,"unknown hardware counter "+name);
+    struct perf_event_attr attr;
+    std::memset(&attr,0,sizeof(attr));
+    attr.size=sizeof(attr);
+    attr.type=PERF_TYPE_HARDWARE;
+    attr.config=perfCounters[found].config;
+    attr.exclude_kernel=1;
+    attr.exclude_hv=1;
+// counters only measure the calling thread, on any cpu
+    int fd=syscall(__NR_perf_event_open,&attr,0,-1,-1,0);
+    if(fd<0){
+      counterError="cannot open hardware counter "+name+": "+std::strerror(errno);
+      for(const auto & f : counterFd) close(f);
+      counterFd.clear();
+      counterNames.clear();
+      return;
+    }
+    counterFd.push_back(fd);
+    counterNames.push_back(name);
+  }
+#else
+  counterError="hardware counters are not available (PLUMED was compiled without perf_event support)";
+#endif
+}
+
+Profiler::~Profiler(){
+#ifdef __PLUMED_HAS_PERF_EVENT
+  for(const auto & f : counterFd) close(f);
+#endif
+}
+
+void Profiler::readCounters(std::vector<unsigned long long>&values)const{
+  values.resize(counterFd.size());
+#ifdef __PLUMED_HAS_PERF_EVENT
+  for(unsigned i=0;i<counterFd.size();i++){
+    unsigned long long v=0;
+    if(read(counterFd[i],&v,sizeof(v))!=sizeof(v)) v=0;
+    values[i]=v;
+  }
+#endif
+}
+
+Profiler::Entry& Profiler::getEntry(const std::string&path){
+  auto it=index.find(path);
+  if(it!=index.end()) return entries[it->second];
+  index[path]=entries.size();
+  entries.push_back(Entry());
+  Entry&e(entries.back());
+  e.path=path;
+  e.histogram.assign(nbins,0);
+  e.counterTotal.assign(counterFd.size(),0);
+  return e;
+}
+
+void Profiler::start(const std::string&path){
+  const bool count=counterFd.size()>0 && std::this_thread::get_id()==owner;
+#pragma omp critical(plumedProfiler)
+  {
+    Entry&e(getEntry(path));
+    plumed_massert(!e.running,"timer "+path+" is already running");
+    e.running=true;
+    e.counting=count;
+    if(count) readCounters(e.counterStart);
+    e.lastStart=std::chrono::high_resolution_clock::now();
+  }
+}
+
+void Profiler::stop(const std::string&path){
+  auto now=std::chrono::high_resolution_clock::now();
+  std::vector<unsigned long long> counterStop;
+#pragma omp critical(plumedProfiler)
+  {
+    Entry&e(getEntry(path));
+    plumed_massert(e.running,"timer "+path+" is not running");
+    if(e.counting){
+      readCounters(counterStop);
+      for(unsigned i=0;i<counterStop.size();i++) e.counterTotal[i]+=counterStop[i]-e.counterStart[i];
+      e.counted++;
+    }
+    e.running=false;
+    long long int lap=std::chrono::duration_cast<std::chrono::nanoseconds>(now-e.lastStart).count();
+    e.calls++;
+    e.total+=lap;
+    if(lap>e.max) e.max=lap;
+    if(e.min>lap || e.calls==1) e.min=lap;
+    int bin=0;
+    if(lap>1) bin=int(std::floor(binsPerOctave*std::log2(double(lap))));
+    if(bin>=int(nbins)) bin=nbins-1;
+    e.histogram[bin]++;
+  }
+}
+
+void Profiler::clear(){
+#pragma omp critical(plumedProfiler)
+  for(auto & e : entries){
+    e.total=e.min=e.max=0;
+    e.calls=e.counted=0;
+    e.histogram.assign(nbins,0);
+    e.counterTotal.assign(counterFd.size(),0);
+  }
+}
+
+double Profiler::getPercentile(const Entry&e,double q)const{
+  if(e.calls==0) return 0.0;
+  const double target=q*e.calls;
+  unsigned long long sum=0;
+  unsigned bin=0;
+  for(bin=0;bin<nbins;bin++){
+    sum+=e.histogram[bin];
+    if(sum>=target) break;
+  }
+// the center of the bin (in log scale) is used, bounded by the observed extremes
+  double t=std::pow(2.0,(bin+0.5)/binsPerOctave);
+  if(t<e.min) t=e.min;
+  if(t>e.max) t=e.max;
+  return t*1e-9;
+}
+
+/// Write a string with JSON escapes
+static void writeJSONString(std::ostream&os,const std::string&s){
+  os<<'"';
+  for(const auto c : s){
+    if(c=='"' || c=='\\') os<<'\\'<<c;
+    else if(c=='\n') os<<"\\n";
+    else if(c=='\t') os<<"\\t";
+    else os<<c;
+  }
+  os<<'"';
+}
+
+void Profiler::writeJSONEntry(std::ostream&os,unsigned i,const std::vector<std::vector<unsigned> >&children,unsigned indent)const{
+  const Entry&e(entries[i]);
+  const std::string pad(indent,' ');
+  const double frac=1e-9;
+  char buffer[1000];
+  const size_t slash=e.path.find_last_of('/');
+  os<<pad<<"{\"name\": ";
+  writeJSONString(os,slash==std::string::npos?e.path:e.path.substr(slash+1));
+  os<<", \"path\": ";
+  writeJSONString(os,e.path);
+  std::sprintf(buffer,", \"calls\": %llu, \"total\": %.9g, \"mean\": %.9g, \"min\": %.9g, \"max\": %.9g, \"p50\": %.9g, \"p90\": %.9g, \"p99\": %.9g",
+               e.calls,frac*e.total,e.calls>0?frac*e.total/e.calls:0.0,frac*e.min,frac*e.max,
+               getPercentile(e,0.5),getPercentile(e,0.9),getPercentile(e,0.99));
+  os<<buffer;
+  if(counterNames.size()>0){
+    os<<", \"counted_calls\": "<<e.counted<<", \"counters\": {";
+    for(unsigned j=0;j<counterNames.size();j++){
+      if(j>0) os<<", ";
+      writeJSONString(os,counterNames[j]);
+      os<<": "<<e.counterTotal[j];
+    }
+    os<<"}";
+  }
+  if(children[i].size()>0){
+    os<<", \"children\": [\n";
+    for(unsigned j=0;j<children[i].size();j++){
+      writeJSONEntry(os,children[i][j],children,indent+2);
+      if(j+1<children[i].size()) os<<",";
+      os<<"\n";
+    }
+    os<<pad<<"]";
+  }
+  os<<"}";
+}
+
+void Profiler::writeJSON(std::ostream&os,long int step)const{
+  std::vector<std::vector<unsigned> > children(entries.size());
+  std::vector<unsigned> roots;
+  for(unsigned i=0;i<entries.size();i++){
+// timers whose parent was never started are shown at the top level
+    const size_t slash=entries[i].path.find_last_of('/');
+    auto parent=index.end();
+    if(slash!=std::string::npos) parent=index.find(entries[i].path.substr(0,slash));
+    if(parent!=index.end()) children[parent->second].push_back(i);
+    else roots.push_back(i);
+  }
+  os<<"{\n";
+  os<<"  \"step\": "<<step<<",\n";
+  os<<"  \"counters\": [";
+  for(unsigned j=0;j<counterNames.size();j++){
+    if(j>0) os<<", ";
+    writeJSONString(os,counterNames[j]);
+  }
+  os<<"],\n";
+  os<<"  \"timers\": [\n";
+  for(unsigned j=0;j<roots.size();j++){
+    writeJSONEntry(os,roots[j],children,4);
+    if(j+1<roots.size()) os<<",";
+    os<<"\n";
+  }
+  os<<"  ]\n";
+  os<<"}\n";
+}
+
+void Profiler::writeCSV(std::ostream&os,long int step)const{
+  const double frac=1e-9;
+  char buffer[1000];
+  os<<"step,path,calls,total,mean,min,max,p50,p90,p99";
+  if(counterNames.size()>0) os<<",counted_calls";
+  for(const auto & c : counterNames) os<<","<<c;
+  os<<"\n";
+  for(const auto & e : entries){
+    os<<step<<",\"";
+    for(const auto c : e.path){
+      if(c=='"') os<<'"';
+      os<<c;
+    }
+    std::sprintf(buffer,"\",%llu,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g",
+                 e.calls,frac*e.total,e.calls>0?frac*e.total/e.calls:0.0,frac*e.min,frac*e.max,
+                 getPercentile(e,0.5),getPercentile(e,0.9),getPercentile(e,0.99));
+    os<<buffer;
+    if(counterNames.size()>0) os<<","<<e.counted;
+    for(const auto & c : e.counterTotal) os<<","<<c;
+    os<<"\n";
+  }
+}
+
+}
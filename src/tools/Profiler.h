@@ -0,0 +1,149 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2012-2017 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#ifndef __PLUMED_tools_Profiler_h
+#define __PLUMED_tools_Profiler_h
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <iosfwd>
+#include <chrono>
+#include <thread>
+namespace PLMD{
+
+/**
+\ingroup TOOLBOX
+Class collecting hierarchical timers with statistics and hardware counters.
+
+Timers are identified by a path where the levels are separated by "/",
+e.g. "calculate/d1/Loop over tasks". Each timer records the number of calls,
+the total, minimum and maximum time and a logarithmic histogram of the times
+of the single calls, from which percentiles are estimated with a relative
+accuracy of about 5%. The same timer can be started and stopped from
+different OpenMP threads, but not concurrently.
+
+Optionally, a list of hardware counters (see getAvailableCounters()) is read
+with the linux perf_event interface when a timer is started and stopped.
+Counters only measure the thread that created the Profiler, so that calls
+on other threads are timed but not counted.
+\verbatim
+#include "Profiler.h"
+int main(){
+  Profiler prof(std::vector<std::string>(1,"cycles"));
+  for(int i=0;i<100;i++){
+    prof.start("loop");
+    prof.start("loop/inner");
+// do calculation
+    prof.stop("loop/inner");
+    prof.stop("loop");
+  }
+  prof.writeJSON(std::cout,100);
+  return 0;
+}
+\endverbatim
+*/
+class Profiler{
+/// Number of histogram bins for a factor two in time
+  static const unsigned binsPerOctave=8;
+/// Total number of histogram bins, from one nanosecond to about 20 minutes
+  static const unsigned nbins=40*binsPerOctave;
+/// Class to store a single timer
+  class Entry{
+  public:
+    std::string path;
+    std::chrono::time_point<std::chrono::high_resolution_clock> lastStart;
+    long long int total = 0;
+    long long int max = 0;
+    long long int min = 0;
+    unsigned long long calls = 0;
+/// Number of calls in which hardware counters were read
+    unsigned long long counted = 0;
+    bool running = false;
+    bool counting = false;
+    std::vector<unsigned long long> histogram;
+    std::vector<unsigned long long> counterStart;
+    std::vector<unsigned long long> counterTotal;
+  };
+/// Timers, in the order in which they were first started
+  std::vector<Entry> entries;
+/// Position of each path in entries
+  std::unordered_map<std::string,unsigned> index;
+/// Current phase, used as first level by the callers
+  std::string phase;
+/// Names of the hardware counters
+  std::vector<std::string> counterNames;
+/// File descriptors of the hardware counters
+  std::vector<int> counterFd;
+/// Thread where the hardware counters are measured
+  std::thread::id owner;
+/// Message explaining why the counters could not be opened
+  std::string counterError;
+/// Read the current value of the hardware counters
+  void readCounters(std::vector<unsigned long long>&)const;
+/// Get the time below which a fraction q of the calls of e were done, in seconds
+  double getPercentile(const Entry&e,double q)const;
+/// Write an entry and its children in JSON format
+  void writeJSONEntry(std::ostream&,unsigned i,const std::vector<std::vector<unsigned> >&children,unsigned indent)const;
+/// Get the entry with a given path, creating it if needed
+  Entry& getEntry(const std::string&path);
+public:
+/// Construct a profiler reading the named hardware counters
+  explicit Profiler(const std::vector<std::string>&counters=std::vector<std::string>());
+  ~Profiler();
+/// List of the names of the hardware counters that can be requested
+  static std::vector<std::string> getAvailableCounters();
+/// Empty if all the requested counters were opened, otherwise the reason
+/// why they are not recorded
+  const std::string & getCounterError()const;
+/// Set the phase of the calculation. This is not used internally and
+/// can only be changed outside of parallel regions.
+  void setPhase(const std::string&);
+/// Get the phase of the calculation
+  const std::string & getPhase()const;
+/// Start timer with a given path
+  void start(const std::string&path);
+/// Stop timer with a given path
+  void stop(const std::string&path);
+/// Reset all the statistics
+  void clear();
+/// Write all the timers as a tree in JSON format. Times are in seconds
+  void writeJSON(std::ostream&,long int step)const;
+/// Write all the timers as comma separated values, one line per timer
+  void writeCSV(std::ostream&,long int step)const;
+};
+
+inline
+void Profiler::setPhase(const std::string&p){
+  phase=p;
+}
+
+inline
+const std::string & Profiler::getPhase()const{
+  return phase;
+}
+
+inline
+const std::string & Profiler::getCounterError()const{
+  return counterError;
+}
+
+}
+#endif
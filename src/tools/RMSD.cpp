@@ -25,6 +25,8 @@
 #include "Exception.h"
 #include <cmath>
 #include <iostream>
+#include <cstdlib>
+#include <algorithm>
 #include "Tools.h"
 using namespace std;
 namespace PLMD{
@@ -333,6 +335,143 @@ double RMSD::simpleAlignment(const  std::vector<double>  & align,
       return dist;
 }
 
+/// Adjugate of a 4x4 matrix, computed from its 2x2 minors. Returns the determinant.
+static double adjugate4(const Tensor4d& a,Tensor4d& adj){
+  const double s0=a[0][0]*a[1][1]-a[1][0]*a[0][1];
+  const double s1=a[0][0]*a[1][2]-a[1][0]*a[0][2];
+  const double s2=a[0][0]*a[1][3]-a[1][0]*a[0][3];
+  const double s3=a[0][1]*a[1][2]-a[1][1]*a[0][2];
+  const double s4=a[0][1]*a[1][3]-a[1][1]*a[0][3];
+  const double s5=a[0][2]*a[1][3]-a[1][2]*a[0][3];
+  const double c5=a[2][2]*a[3][3]-a[3][2]*a[2][3];
+  const double c4=a[2][1]*a[3][3]-a[3][1]*a[2][3];
+  const double c3=a[2][1]*a[3][2]-a[3][1]*a[2][2];
+  const double c2=a[2][0]*a[3][3]-a[3][0]*a[2][3];
+  const double c1=a[2][0]*a[3][2]-a[3][0]*a[2][2];
+  const double c0=a[2][0]*a[3][1]-a[3][0]*a[2][1];
+  adj[0][0]= a[1][1]*c5-a[1][2]*c4+a[1][3]*c3;
+  adj[0][1]=-a[0][1]*c5+a[0][2]*c4-a[0][3]*c3;
+  adj[0][2]= a[3][1]*s5-a[3][2]*s4+a[3][3]*s3;
+  adj[0][3]=-a[2][1]*s5+a[2][2]*s4-a[2][3]*s3;
+  adj[1][0]=-a[1][0]*c5+a[1][2]*c2-a[1][3]*c1;
+  adj[1][1]= a[0][0]*c5-a[0][2]*c2+a[0][3]*c1;
+  adj[1][2]=-a[3][0]*s5+a[3][2]*s2-a[3][3]*s1;
+  adj[1][3]= a[2][0]*s5-a[2][2]*s2+a[2][3]*s1;
+  adj[2][0]= a[1][0]*c4-a[1][1]*c2+a[1][3]*c0;
+  adj[2][1]=-a[0][0]*c4+a[0][1]*c2-a[0][3]*c0;
+  adj[2][2]= a[3][0]*s4-a[3][1]*s2+a[3][3]*s0;
+  adj[2][3]=-a[2][0]*s4+a[2][1]*s2-a[2][3]*s0;
+  adj[3][0]=-a[1][0]*c3+a[1][1]*c1-a[1][2]*c0;
+  adj[3][1]= a[0][0]*c3-a[0][1]*c1+a[0][2]*c0;
+  adj[3][2]=-a[3][0]*s3+a[3][1]*s1-a[3][2]*s0;
+  adj[3][3]= a[2][0]*s3-a[2][1]*s1+a[2][2]*s0;
+  return s0*c5-s1*c4+s2*c3+s3*c2-s4*c1+s5*c0;
+}
+
+/// Lowest eigenpair of the symmetric 4x4 quaternion matrix m using LAPACK.
+/// If pinv is not NULL it is set to sum_l v_l v_l^T / (lambda_0-lambda_l), which is
+/// what first order perturbation theory needs for the derivatives of the eigenvector.
+static void lowestEigenpair4Lapack(const Tensor4d& m,double& lambda,Vector4d& q,Tensor4d* pinv){
+  Matrix<double> mm(4,4);
+  for(unsigned i=0;i<4;i++) for(unsigned j=0;j<4;j++) mm[i][j]=m[i][j];
+  vector<double> eigenvals;
+  Matrix<double> eigenvecs;
+  int diagerror=diagMat(mm, eigenvals, eigenvecs );
+
+  if (diagerror!=0){
+    string sdiagerror;
+    Tools::convert(diagerror,sdiagerror);
+    string msg="DIAGONALIZATION FAILED WITH ERROR CODE "+sdiagerror;
+    plumed_merror(msg);
+  }
+  lambda=eigenvals[0];
+  q=Vector4d(eigenvecs[0][0],eigenvecs[0][1],eigenvecs[0][2],eigenvecs[0][3]);
+  if(pinv){
+    pinv->zero();
+    for(unsigned l=1;l<4;l++) for(unsigned i=0;i<4;i++) for(unsigned j=0;j<4;j++)
+      (*pinv)[i][j]+=eigenvecs[l][i]*eigenvecs[l][j]/(eigenvals[0]-eigenvals[l]);
+  }
+}
+
+/// Lowest eigenpair of the symmetric 4x4 quaternion matrix m.
+/// The eigenvalue is the smallest root of the characteristic polynomial, found with Newton
+/// iterations started from the Gershgorin lower bound (so that they converge monotonically).
+/// The eigenvector is a column of the adjugate of m-lambda.
+/// It falls back to LAPACK when the lowest eigenvalue is (nearly) degenerate or when
+/// the environment variable PLUMED_RMSD_LAPACK is set, which is useful for validation.
+static void lowestEigenpair4(const Tensor4d& m,double& lambda,Vector4d& q,Tensor4d* pinv){
+  static const bool useLapack=(std::getenv("PLUMED_RMSD_LAPACK")!=NULL);
+  if(useLapack){
+    lowestEigenpair4Lapack(m,lambda,q,pinv);
+    return;
+  }
+
+  double scale=0.0;
+  double lower=0.0;
+  for(unsigned i=0;i<4;i++){
+    double offdiag=0.0;
+    for(unsigned j=0;j<4;j++){
+      scale=std::max(scale,std::fabs(m[i][j]));
+      if(j!=i) offdiag+=std::fabs(m[i][j]);
+    }
+    if(i==0 || m[i][i]-offdiag<lower) lower=m[i][i]-offdiag;
+  }
+  if(scale==0.0){
+    lowestEigenpair4Lapack(m,lambda,q,pinv);
+    return;
+  }
+
+// det(m-x) = x^4 - c3 x^3 + c2 x^2 - c1 x + c0
+  Tensor4d adj;
+  const double c0=adjugate4(m,adj);
+  const double c1=adj[0][0]+adj[1][1]+adj[2][2]+adj[3][3];
+  double c2=0.0;
+  for(unsigned i=0;i<4;i++) for(unsigned j=i+1;j<4;j++) c2+=m[i][i]*m[j][j]-m[i][j]*m[j][i];
+  const double c3=m[0][0]+m[1][1]+m[2][2]+m[3][3];
+
+  lambda=lower;
+  bool converged=false;
+  for(unsigned iter=0;iter<100;iter++){
+    const double x=lambda;
+    const double p=(((x-c3)*x+c2)*x-c1)*x+c0;
+    const double dp=((4.0*x-3.0*c3)*x+2.0*c2)*x-c1;
+    if(dp==0.0) break;
+    const double delta=p/dp;
+    lambda-=delta;
+    if(std::fabs(delta)<=1e-14*scale){converged=true; break;}
+  }
+  if(!converged){
+    lowestEigenpair4Lapack(m,lambda,q,pinv);
+    return;
+  }
+
+// adj(m-lambda) is proportional to q q^T; the column with the largest diagonal element is the most accurate
+  Tensor4d a(m);
+  for(unsigned i=0;i<4;i++) a[i][i]-=lambda;
+  adjugate4(a,adj);
+  unsigned best=0;
+  for(unsigned i=1;i<4;i++) if(adj[i][i]>adj[best][best]) best=i;
+// adj[best][best] is q[best]^2 times the product of the three gaps, so it is small if lambda is degenerate
+  if(!(adj[best][best]>1e-10*scale*scale*scale)){
+    lowestEigenpair4Lapack(m,lambda,q,pinv);
+    return;
+  }
+  q=Vector4d(adj[0][best],adj[1][best],adj[2][best],adj[3][best]);
+  q/=q.modulo();
+// Rayleigh quotient, which is accurate to second order in the error on q
+  lambda=dotProduct(q,matmul(m,q));
+
+  if(pinv){
+// a+scale*q*q^T has the same eigenvectors as m, with q moved away from zero.
+// Its inverse is sum_l v_l v_l^T / (lambda_l-lambda_0) + q q^T / scale
+    Tensor4d qq(q,q);
+    for(unsigned i=0;i<4;i++) a[i][i]=m[i][i]-lambda;
+    a+=scale*qq;
+    const double det=adjugate4(a,adj);
+    *pinv=(1.0/scale)*qq-(1.0/det)*adj;
+  }
+}
+
 // this below enable the standard case for rmsd where the rmsd is calculated and the derivative of rmsd respect to positions is retrieved
 // additionally this assumes that the com of the reference is already subtracted.    
 #define OLDRMSD
@@ -371,7 +510,7 @@ double RMSD::optimalAlignment(const  std::vector<double>  & align,
     rr01+=Tensor(positions[iat]-cpositions,reference[iat])*w;
   }
 
-  Matrix<double> m=Matrix<double>(4,4);
+  Tensor4d m;
   m[0][0]=2.0*(-rr01[0][0]-rr01[1][1]-rr01[2][2]);
   m[1][1]=2.0*(-rr01[0][0]+rr01[1][1]+rr01[2][2]);
   m[2][2]=2.0*(+rr01[0][0]-rr01[1][1]+rr01[2][2]);
@@ -409,32 +548,18 @@ double RMSD::optimalAlignment(const  std::vector<double>  & align,
     dm_drr01[3][2] = dm_drr01[2][3];
   }
 
-  vector<double> eigenvals;
-  Matrix<double> eigenvecs;
-  int diagerror=diagMat(m, eigenvals, eigenvecs );
-
-  if (diagerror!=0){
-    string sdiagerror;
-    Tools::convert(diagerror,sdiagerror);
-    string msg="DIAGONALIZATION FAILED WITH ERROR CODE "+sdiagerror;
-    plumed_merror(msg);
-  }
-
-  dist=eigenvals[0]+rr00+rr11;
-
-  Matrix<double> ddist_dm(4,4);
+  double eigenval;
+  Vector4d q;
+  Tensor4d pinv;
+  lowestEigenpair4(m,eigenval,q,(alEqDis?NULL:&pinv));
 
-  Vector4d q(eigenvecs[0][0],eigenvecs[0][1],eigenvecs[0][2],eigenvecs[0][3]);
+  dist=eigenval+rr00+rr11;
 
   Tensor dq_drr01[4];
   if(!alEqDis){
     double dq_dm[4][4][4];
-    for(unsigned i=0;i<4;i++) for(unsigned j=0;j<4;j++) for(unsigned k=0;k<4;k++){
-      double tmp=0.0;
 // perturbation theory for matrix m
-      for(unsigned l=1;l<4;l++) tmp+=eigenvecs[l][j]*eigenvecs[l][i]/(eigenvals[0]-eigenvals[l])*eigenvecs[0][k];
-      dq_dm[i][j][k]=tmp;
-    }
+    for(unsigned i=0;i<4;i++) for(unsigned j=0;j<4;j++) for(unsigned k=0;k<4;k++) dq_dm[i][j][k]=pinv[i][j]*q[k];
 // propagation to _drr01
     for(unsigned i=0;i<4;i++){
       Tensor tmp;
@@ -559,6 +684,127 @@ double RMSD::optimalAlignment(const  std::vector<double>  & align,
    return dist;    
 }
 #endif
+
+RMSDBatch::RMSDBatch():
+  natoms(0),
+  nref(0),
+  safe(true)
+{
+}
+
+void RMSDBatch::clear(){
+  natoms=0;
+  nref=0;
+  safe=true;
+  align.clear();
+  reference.clear();
+  rr11.clear();
+}
+
+bool RMSDBatch::add(const RMSD& rmsd){
+  if(rmsd.alignmentMethod!=RMSD::OPTIMAL && rmsd.alignmentMethod!=RMSD::OPTIMAL_FAST) return false;
+  if(!rmsd.reference_center_is_removed) return false;
+  if(rmsd.align!=rmsd.displace) return false;
+  const bool s=(rmsd.alignmentMethod==RMSD::OPTIMAL);
+  if(nref==0){
+    natoms=rmsd.reference.size();
+    safe=s;
+    align=rmsd.align;
+  } else if(s!=safe || rmsd.align!=align) return false;
+
+// insert the new reference as the last one of each atom
+  std::vector<Vector> newreference(natoms*(nref+1));
+  for(unsigned iat=0;iat<natoms;iat++){
+    for(unsigned k=0;k<nref;k++) newreference[iat*(nref+1)+k]=reference[iat*nref+k];
+    newreference[iat*(nref+1)+nref]=rmsd.reference[iat];
+  }
+  reference.swap(newreference);
+  double r=0.0;
+  for(unsigned iat=0;iat<natoms;iat++) r+=dotProduct(rmsd.reference[iat],rmsd.reference[iat])*align[iat];
+  rr11.push_back(r);
+  nref++;
+  return true;
+}
+
+// this follows step by step RMSD::optimalAlignment<safe,true>, so that results are identical
+void RMSDBatch::calculate(const std::vector<Vector> & positions,const std::vector<unsigned> & frames,
+                          std::vector<double> & distances,std::vector<Vector> & derivatives,bool squared)const{
+  const unsigned nf=frames.size();
+  plumed_assert(positions.size()==natoms);
+  distances.assign(nf,0.0);
+  derivatives.resize(nf*natoms);
+  if(nf==0) return;
+
+// the positions are centered only once
+  Vector cpositions;
+  for(unsigned iat=0;iat<natoms;iat++) cpositions+=positions[iat]*align[iat];
+  double rr00(0);
+  std::vector<Vector> centered(natoms);
+  for(unsigned iat=0;iat<natoms;iat++){
+    centered[iat]=positions[iat]-cpositions;
+    rr00+=dotProduct(centered[iat],centered[iat])*align[iat];
+  }
+
+// single sweep over atoms to accumulate all the correlation matrices
+  std::vector<Tensor> rr01(nf);
+  for(unsigned iat=0;iat<natoms;iat++){
+    const double w=align[iat];
+    const Vector* ref=&reference[iat*nref];
+    for(unsigned j=0;j<nf;j++) rr01[j]+=Tensor(centered[iat],ref[frames[j]])*w;
+  }
+
+  for(unsigned j=0;j<nf;j++){
+    const Tensor & r=rr01[j];
+    const Vector* ref=&reference[frames[j]];
+    Tensor4d m;
+    m[0][0]=2.0*(-r[0][0]-r[1][1]-r[2][2]);
+    m[1][1]=2.0*(-r[0][0]+r[1][1]+r[2][2]);
+    m[2][2]=2.0*(+r[0][0]-r[1][1]+r[2][2]);
+    m[3][3]=2.0*(+r[0][0]+r[1][1]-r[2][2]);
+    m[0][1]=2.0*(-r[1][2]+r[2][1]);
+    m[0][2]=2.0*(+r[0][2]-r[2][0]);
+    m[0][3]=2.0*(-r[0][1]+r[1][0]);
+    m[1][2]=2.0*(-r[0][1]-r[1][0]);
+    m[1][3]=2.0*(-r[0][2]-r[2][0]);
+    m[2][3]=2.0*(-r[1][2]-r[2][1]);
+    m[1][0] = m[0][1];
+    m[2][0] = m[0][2];
+    m[2][1] = m[1][2];
+    m[3][0] = m[0][3];
+    m[3][1] = m[1][3];
+    m[3][2] = m[2][3];
+
+    double eigenval;
+    Vector4d q;
+    lowestEigenpair4(m,eigenval,q,NULL);
+    double dist=eigenval+rr00+rr11[frames[j]];
+
+    Tensor rotation;
+    rotation[0][0]=q[0]*q[0]+q[1]*q[1]-q[2]*q[2]-q[3]*q[3];
+    rotation[1][1]=q[0]*q[0]-q[1]*q[1]+q[2]*q[2]-q[3]*q[3];
+    rotation[2][2]=q[0]*q[0]-q[1]*q[1]-q[2]*q[2]+q[3]*q[3];
+    rotation[0][1]=2*(+q[0]*q[3]+q[1]*q[2]);
+    rotation[0][2]=2*(-q[0]*q[2]+q[1]*q[3]);
+    rotation[1][2]=2*(+q[0]*q[1]+q[2]*q[3]);
+    rotation[1][0]=2*(-q[0]*q[3]+q[1]*q[2]);
+    rotation[2][0]=2*(+q[0]*q[2]+q[1]*q[3]);
+    rotation[2][1]=2*(-q[0]*q[1]+q[2]*q[3]);
+
+    double prefactor=2.0;
+    if(!squared) prefactor*=0.5/sqrt(dist);
+    if(safe) dist=0.0;
+
+// derivatives of rotation and shift are zero by construction, since align==displace
+    Vector* der=&derivatives[j*natoms];
+    for(unsigned iat=0;iat<natoms;iat++){
+      Vector d(centered[iat] - matmul(rotation,ref[iat*nref]));
+      der[iat]=prefactor*align[iat]*d;
+      if(safe) dist+=align[iat]*modulo2(d);
+    }
+    if(!squared) dist=sqrt(dist);
+    distances[j]=dist;
+  }
+}
 template <bool safe,bool alEqDis>
 double RMSD::optimalAlignment_DDistDRef(const  std::vector<double>  & align,
                               const  std::vector<double>  & displace,
@@ -814,7 +1060,7 @@ void RMSDCoreData::doCoreCalc(bool safe,bool alEqDis, bool only_rotation){
   }
 
 // the quaternion matrix: this is internal
-  Matrix<double> m=Matrix<double>(4,4);
+  Tensor4d m;
 
   m[0][0]=2.0*(-rr01[0][0]-rr01[1][1]-rr01[2][2]);
   m[1][1]=2.0*(-rr01[0][0]+rr01[1][1]+rr01[2][2]);
@@ -855,27 +1101,15 @@ void RMSDCoreData::doCoreCalc(bool safe,bool alEqDis, bool only_rotation){
   }
 
 
-  int diagerror=diagMat(m, eigenvals, eigenvecs );
-
-  if (diagerror!=0){
-    std::string sdiagerror;
-    Tools::convert(diagerror,sdiagerror);
-    std::string msg="DIAGONALIZATION FAILED WITH ERROR CODE "+sdiagerror;
-    plumed_merror(msg);
-  }
-
-  Vector4d q(eigenvecs[0][0],eigenvecs[0][1],eigenvecs[0][2],eigenvecs[0][3]);
-//  cerr<<"EIGENVAL "<<eigenvals[0]<<" "<<eigenvals[1]<<" "<<eigenvals[2]<<" "<<eigenvals[3]<<"\n";
+  Vector4d q;
+  Tensor4d pinv;
+  lowestEigenpair4(m,eigenval,q,((!alEqDis or !only_rotation)?&pinv:NULL));
 
   Tensor dq_drr01[4];
   if(!alEqDis or !only_rotation){
     double dq_dm[4][4][4];
-    for(unsigned i=0;i<4;i++) for(unsigned j=0;j<4;j++) for(unsigned k=0;k<4;k++){
-      double tmp=0.0;
 // perturbation theory for matrix m
-      for(unsigned l=1;l<4;l++) tmp+=eigenvecs[l][j]*eigenvecs[l][i]/(eigenvals[0]-eigenvals[l])*eigenvecs[0][k];
-      dq_dm[i][j][k]=tmp;
-    }
+    for(unsigned i=0;i<4;i++) for(unsigned j=0;j<4;j++) for(unsigned k=0;k<4;k++) dq_dm[i][j][k]=pinv[i][j]*q[k];
 // propagation to _drr01
     for(unsigned i=0;i<4;i++){
       Tensor tmp;
@@ -939,7 +1173,7 @@ void RMSDCoreData::doCoreCalc(bool safe,bool alEqDis, bool only_rotation){
 double RMSDCoreData::getDistance( bool squared){
 
   if(!isInitialized)plumed_merror("getDistance cannot calculate the distance without being initialized first by doCoreCalc ");
-  dist=eigenvals[0]+rr00+rr11;
+  dist=eigenval+rr00+rr11;
   
   if(safe || !alEqDis) dist=0.0;
   const unsigned n=static_cast<unsigned int>(reference.size());
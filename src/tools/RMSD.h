@@ -62,6 +62,7 @@ val=rmsd.calculate(getPositions(),derivs,true);
 
 class RMSD
 {
+  friend class RMSDBatch;
   enum AlignmentMethod {SIMPLE, OPTIMAL, OPTIMAL_FAST};
   AlignmentMethod alignmentMethod;
 // Reference coordinates
@@ -218,6 +219,50 @@ double optimalAlignment_Fit(const  std::vector<double>  & align,
  }; 
 };
 
+/** \ingroup TOOLBOX
+A class that computes the optimal-alignment MSD of a set of positions from many references at once.
+
+All the references should share the same alignment and displacement weights, and these
+two sets of weights should be identical (as it is for instance in \ref PATHMSD).
+The positions are then centered only once, and the correlation matrices with all the
+references are accumulated in a single sweep over the atoms. The result is identical to
+calling RMSD::calculate() on each reference.
+\verbatim
+RMSDBatch batch;
+for(unsigned i=0;i<rmsds.size();i++) if(!batch.add(rmsds[i])) ... // fallback to RMSD::calculate()
+std::vector<unsigned> frames; // the references that should be computed
+std::vector<double> dist;
+std::vector<Vector> derivs; // derivatives of frame frames[j] wrt atom i are in derivs[j*natoms+i]
+batch.calculate(getPositions(),frames,dist,derivs,true);
+\endverbatim
+*/
+class RMSDBatch
+{
+/// Number of atoms
+  unsigned natoms;
+/// Number of references
+  unsigned nref;
+/// Use the safe (OPTIMAL) or the fast (OPTIMAL-FAST) flavor
+  bool safe;
+/// Weights, common to all the references
+  std::vector<double> align;
+/// References, with the center removed. Stored atom by atom, i.e. atom i of reference k is reference[i*nref+k]
+  std::vector<Vector> reference;
+/// Trace of reference*reference for each reference
+  std::vector<double> rr11;
+public:
+  RMSDBatch();
+/// Remove all the references
+  void clear();
+/// Add a reference. Returns false (and does not add it) if rmsd cannot be computed in batch with the other references
+  bool add(const RMSD& rmsd);
+/// Number of references
+  unsigned size()const{return nref;}
+/// Compute distances (and derivatives wrt positions) from the references listed in frames
+  void calculate(const std::vector<Vector> & positions,const std::vector<unsigned> & frames,
+                 std::vector<double> & distances,std::vector<Vector> & derivatives,bool squared=false)const;
+};
+
 /// this is a class which is needed to share information across the various non-threadsafe routines
 /// so that the public function of rmsd are threadsafe while the inner core can safely share information 
 class RMSDCoreData
@@ -244,10 +289,9 @@ class RMSDCoreData
                 const std::vector<double> &align; 
                 const std::vector<double> &displace; 
 
-		// the needed stuff for distance and more (one could use eigenvecs components and eigenvals for some reason)
+		// the needed stuff for distance and more
 		double dist;
-		std::vector<double> eigenvals;
-		Matrix<double> eigenvecs;
+		double eigenval; // smallest eigenvalue of the quaternion matrix
 		double rr00; //  sum of positions squared (needed for dist calc)
 		double rr11; //  sum of reference squared (needed for dist calc)
 		Tensor rotation; // rotation derived from the eigenvector having the smallest eigenvalue
@@ -263,13 +307,13 @@ class RMSDCoreData
 		RMSDCoreData(const std::vector<double> &a ,const std::vector<double> &d,const std::vector<Vector> &p, const std::vector<Vector> &r, Vector &cp, Vector &cr ):
 			alEqDis(false),distanceIsMSD(false),hasDistance(false),isInitialized(false),safe(false),
 			creference(cr),creference_is_calculated(true),creference_is_removed(true),
-			cpositions(cp),cpositions_is_calculated(true),cpositions_is_removed(true),retrieve_only_rotation(false),positions(p),reference(r),align(a),displace(d),dist(0.0),rr00(0.0),rr11(0.0){};
+			cpositions(cp),cpositions_is_calculated(true),cpositions_is_removed(true),retrieve_only_rotation(false),positions(p),reference(r),align(a),displace(d),dist(0.0),eigenval(0.0),rr00(0.0),rr11(0.0){};
 
 		// this constructor does not assume that the positions and reference have the center subtracted
 		RMSDCoreData(const std::vector<double> &a ,const std::vector<double> &d,const std::vector<Vector> &p, const std::vector<Vector> &r):
 			alEqDis(false),distanceIsMSD(false),hasDistance(false),isInitialized(false),safe(false),
 			creference_is_calculated(false),creference_is_removed(false),
-			cpositions_is_calculated(false),cpositions_is_removed(false),retrieve_only_rotation(false),positions(p),reference(r),align(a),displace(d),dist(0.0),rr00(0.0),rr11(0.0)
+			cpositions_is_calculated(false),cpositions_is_removed(false),retrieve_only_rotation(false),positions(p),reference(r),align(a),displace(d),dist(0.0),eigenval(0.0),rr00(0.0),rr11(0.0)
 			{cpositions.zero();creference.zero();};
 
 		// set the center on the fly without subtracting
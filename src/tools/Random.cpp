@@ -20,6 +20,7 @@
    along with plumed.  If not, see <http://www.gnu.org/licenses/>.
 +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 #include "Random.h"
+#include "Tools.h"
 #include <cmath>
 #include <cstdlib>
 #include <sstream>
@@ -131,6 +132,22 @@ void Random::fromString(const std::string & str){
 	for (int i = 0; i < NTAB; i++) istr>>iv[i];
 }
 
+void Random::writeBinary(std::ostream & out)const{
+	Tools::writeBinary(out,switchGaussian);
+	Tools::writeBinary(out,saveGaussian);
+	Tools::writeBinary(out,iy);
+	Tools::writeBinary(out,iv);
+	Tools::writeBinary(out,idum);
+}
+
+void Random::readBinary(std::istream & in){
+	Tools::readBinary(in,switchGaussian);
+	Tools::readBinary(in,saveGaussian);
+	Tools::readBinary(in,iy);
+	Tools::readBinary(in,iv);
+	Tools::readBinary(in,idum);
+}
+
 // This allows to have the same stream of random numbers
 // with different compilers:
 #ifdef __INTEL_COMPILER
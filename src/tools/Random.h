@@ -53,6 +53,9 @@ public:
 	void ReadStateFull (std::istream &);
 	void fromString(const std::string & str);
 	void toString(std::string & str)const;
+/// write the full state, including the stored gaussian number, in a binary checkpoint
+	void writeBinary(std::ostream &)const;
+	void readBinary(std::istream &);
 	friend std::ostream & operator<<(std::ostream & out,const Random & rng){
 		rng.WriteStateFull(out); return out;
 	}
@@ -24,6 +24,8 @@
 #include "Keywords.h"
 #include <vector>
 #include <limits>
+#include <cmath>
+#include <algorithm>
 
 #ifdef __PLUMED_HAS_MATHEVAL
 #include <matheval.h>
@@ -151,6 +153,22 @@ removed in the future. Similarly, the STRETCH keyword is still allowed but has n
 Notice that switching functions defined with the simplified syntax are never stretched
 for backward compatibility. This might change in the future.
 
+Switching functions that are expensive to compute (e.g. SMAP, MATHEVAL or RATIONAL with odd exponents
+or with a nonzero D_0) can be replaced by a table of cubic splines between D_0 and D_MAX
+using the TABLE parameter, which gives the largest error that is allowed
+on the switching function and on its derivative multiplied by R_0. 
+The number of points in the table is increased until the error, which is checked at three
+points between each pair of nodes, is below this value.
+Notice that this is an empirical bound: it is only guaranteed on the points where the error has been checked,
+and the error at other distances can be (usually slightly) larger, in particular close to points
+where the switching function or its derivatives change quickly. For instance
+\verbatim
+KEYWORD={SMAP R_0=0.5 A=6 B=12 D_MAX=1.5 TABLE=1e-7}
+\endverbatim
+The number of points and the errors that have been found are written in the log.
+D_MAX is required when using TABLE. For RATIONAL functions with even exponents and no D_0
+direct evaluation is usually faster than the table.
+
 */
 //+ENDPLUMEDOC
 
@@ -192,6 +210,11 @@ void SwitchingFunction::set(const std::string & definition,std::string& errormsg
   bool dontstretch=false;
   Tools::parseFlag(data,"NOSTRETCH",dontstretch); // this is ignored now
   if(dontstretch) dostretch=false;
+  tableTolerance=0.0;
+  table.clear();
+  present=Tools::findKeyword(data,"TABLE");
+  if(present && !Tools::parse(data,"TABLE",tableTolerance)) errormsg="could not parse TABLE";
+  if(present && tableTolerance<=0.0) errormsg="TABLE should be positive";
   double r0;
   if(name=="CUBIC"){
      r0 = dmax - d0;
@@ -269,6 +292,7 @@ void SwitchingFunction::set(const std::string & definition,std::string& errormsg
     stretch=1.0/(s0-sd);
     shift=-sd*stretch;
   }
+  if(tableTolerance>0.0 && errormsg.length()==0) buildTable(errormsg);
 }
 
 std::string SwitchingFunction::description() const {
@@ -310,10 +334,18 @@ std::string SwitchingFunction::description() const {
 #endif
 
   }
+  if(table.size()>0){
+    ostr<<", tabulated with "<<table.size()/2<<" points (largest error "<<tableValueError
+        <<" on the function and "<<tableDerivError<<" on its derivative times r_0)";
+  }
   return ostr.str(); 
 }
 
-double SwitchingFunction::do_rational(double rdist,double&dfunc,int nn,int mm)const{
+namespace {
+
+/// Low-level tool to compute rational functions.
+/// It is separated since it is called both by calculate() and calculateSqr()
+inline double doRational(double rdist,double&dfunc,int nn,int mm){
       double result;
       if(2*nn==mm){
 // if 2*N==M, then (1.0-rdist^N)/(1.0-rdist^M) = 1.0/(1.0+rdist^N)
@@ -338,14 +370,201 @@ double SwitchingFunction::do_rational(double rdist,double&dfunc,int nn,int mm)co
     return result;
 }
 
+// The following classes compute the different switching functions as a function
+// of rdist=(r-d_0)/r_0, setting dfunc to the derivative with respect to rdist.
+// They are shared by calculate() and by the batch version of calculateSqr(),
+// so that the two give identical results.
+
+class RationalFunction{
+  int nn,mm;
+public:
+  RationalFunction(int nn,int mm): nn(nn), mm(mm) {}
+  double operator()(double rdist,double distance,double&dfunc)const{
+    return doRational(rdist,dfunc,nn,mm);
+  }
+};
+
+class SmapFunction{
+  int a,b;
+  double c,d;
+public:
+  SmapFunction(int a,int b,double c,double d): a(a), b(b), c(c), d(d) {}
+  double operator()(double rdist,double distance,double&dfunc)const{
+    double sx=c*pow( rdist, a );
+    double result=pow( 1.0 + sx, d );
+    dfunc=-b*sx/rdist*result/(1.0+sx);
+    return result;
+  }
+};
+
+class ExponentialFunction{
+public:
+  double operator()(double rdist,double distance,double&dfunc)const{
+    double result=exp(-rdist);
+    dfunc=-result;
+    return result;
+  }
+};
+
+class NativeQFunction{
+  double beta,lambda,ref;
+public:
+  NativeQFunction(double beta,double lambda,double ref): beta(beta), lambda(lambda), ref(ref) {}
+  double operator()(double rdist,double distance,double&dfunc)const{
+    double rdist2 = beta*(distance - lambda * ref);
+    double exprdist=exp(rdist2);
+    dfunc=-exprdist/(1.+exprdist)/(1.+exprdist);
+    return 1./(1.+exprdist);
+  }
+};
+
+class GaussianFunction{
+public:
+  double operator()(double rdist,double distance,double&dfunc)const{
+    double result=exp(-0.5*rdist*rdist);
+    dfunc=-rdist*result;
+    return result;
+  }
+};
+
+class CubicFunction{
+public:
+  double operator()(double rdist,double distance,double&dfunc)const{
+    double tmp1=rdist-1, tmp2=(1+2*rdist);
+    dfunc=2*tmp1*tmp2 + 2*tmp1*tmp1;
+    return tmp1*tmp1*tmp2;
+  }
+};
+
+class TanhFunction{
+public:
+  double operator()(double rdist,double distance,double&dfunc)const{
+    double tmp1=std::tanh(rdist);
+    dfunc=-(1-tmp1*tmp1);
+    return 1.0 - tmp1;
+  }
+};
+
+#ifdef __PLUMED_HAS_MATHEVAL
+class MathevalFunction{
+  void* evaluator;
+  void* evaluator_deriv;
+public:
+  MathevalFunction(void*evaluator,void*evaluator_deriv): evaluator(evaluator), evaluator_deriv(evaluator_deriv) {}
+  double operator()(double rdist,double distance,double&dfunc)const{
+    dfunc=evaluator_evaluate_x(evaluator_deriv,rdist);
+    return evaluator_evaluate_x(evaluator,rdist);
+  }
+};
+#endif
+
+/// Parameters common to all the switching functions
+class Range{
+public:
+  double d0,invr0,dmax,stretch,shift;
+  Range(double d0,double invr0,double dmax,double stretch,double shift):
+    d0(d0), invr0(invr0), dmax(dmax), stretch(stretch), shift(shift) {}
+};
+
+/// Compute function f at a given distance, including the cutoff at dmax, the plateau
+/// below d0 and the stretching. dfunc is set to the derivative divided by the distance.
+template<class F>
+inline double evaluate(const F&f,const Range&range,double distance,double&dfunc){
+  if(distance>range.dmax){
+    dfunc=0.0;
+    return 0.0;
+  }
+  const double rdist = (distance-range.d0)*range.invr0;
+  double result;
+
+  if(rdist<=0.){
+     result=1.;
+     dfunc=0.0;
+  }else{
+    result=f(rdist,distance,dfunc);
+// this is for the chain rule:
+    dfunc*=range.invr0;
+// this is because calculate() sets dfunc to the derivative divided times the distance.
+// (I think this is misleading and I would like to modify it - GB)
+    dfunc/=distance;
+  }
+
+  result=result*range.stretch+range.shift;
+  dfunc*=range.stretch;
+
+  return result;
+}
+
+/// Same as evaluate() on the square root of n squared distances.
+/// All the branches are replaced by selections, so that the loop can be vectorized.
+template<class F>
+void evaluateBatch(const F&f,const Range&range,const double*distance2,double*value,double*dfunc,unsigned n){
+  for(unsigned i=0;i<n;i++){
+    const double distance=std::sqrt(distance2[i]);
+    const double rdist = (distance-range.d0)*range.invr0;
+    double df;
+    double result=f(rdist,distance,df);
+    df*=range.invr0;
+    df/=distance;
+    const bool plateau=(rdist<=0.);
+    result=plateau?1.0:result;
+    df=plateau?0.0:df;
+    result=result*range.stretch+range.shift;
+    df*=range.stretch;
+    const bool cut=(distance>range.dmax);
+    value[i]=cut?0.0:result;
+    dfunc[i]=cut?0.0:df;
+  }
+}
+
+/// Rational function with even exponents and d_0=0, computed on the squared distance.
+/// With N>0, exponents are nn=2N and mm=4N and are fixed at compile time.
+template<int N>
+void rationalSqrBatch(int nn,int mm,double invr0_2,double dmax_2,double stretch,double shift,
+                      const double*distance2,double*value,double*dfunc,unsigned n){
+  if(N>0){ nn=2*N; mm=4*N; }
+  for(unsigned i=0;i<n;i++){
+    const double rdist_2 = distance2[i]*invr0_2;
+    double df;
+    double result=doRational(rdist_2,df,nn/2,mm/2);
+// chain rule:
+    df*=2*invr0_2;
+// stretch:
+    result=result*stretch+shift;
+    df*=stretch;
+    const bool cut=(distance2[i]>dmax_2);
+    value[i]=cut?0.0:result;
+    dfunc[i]=cut?0.0:df;
+  }
+}
+
+/// Cubic Hermite interpolation of a table with nodes at d0+i*delta,
+/// storing values and derivatives. Sets deriv to the derivative with respect to the distance.
+inline double interpolateTable(const std::vector<double>&table,double d0,double delta,double invDelta,double distance,double&deriv){
+  const unsigned last=table.size()/2-2;
+  double t=(distance-d0)*invDelta;
+  t=(t<0.0?0.0:t);
+  t=(t>last+1?last+1:t);
+  unsigned i=unsigned(t);
+  i=(i>last?last:i);
+  const double u=t-i;
+  const double f0=table[2*i], g0=table[2*i+1]*delta;
+  const double f1=table[2*i+2], g1=table[2*i+3]*delta;
+  const double um=1.0-u;
+  deriv=(6.0*u*um*(f1-f0)+um*(1.0-3.0*u)*g0+u*(3.0*u-2.0)*g1)*invDelta;
+  return um*um*((1.0+2.0*u)*f0+u*g0)+u*u*((3.0-2.0*u)*f1-um*g1);
+}
+
+}
+
 double SwitchingFunction::calculateSqr(double distance2,double&dfunc)const{
-  if(type==rational && nn%2==0 && mm%2==0 && d0==0.0){
+  if(table.size()==0 && type==rational && nn%2==0 && mm%2==0 && d0==0.0){
     if(distance2>dmax_2){
       dfunc=0.0;
       return 0.0;
     }
     const double rdist_2 = distance2*invr0_2;
-    double result=do_rational(rdist_2,dfunc,nn/2,mm/2);
+    double result=doRational(rdist_2,dfunc,nn/2,mm/2);
 // chain rule:
     dfunc*=2*invr0_2;
 // stretch:
@@ -358,61 +577,135 @@ double SwitchingFunction::calculateSqr(double distance2,double&dfunc)const{
   }
 }
 
-double SwitchingFunction::calculate(double distance,double&dfunc)const{
+void SwitchingFunction::calculateSqr(const double*distance2,double*value,double*dfunc,unsigned n)const{
   plumed_massert(init,"you are trying to use an unset SwitchingFunction");
-  if(distance>dmax){
-    dfunc=0.0;
-    return 0.0;
+  if(table.size()>0){
+    const double plateau=stretch+shift;
+    for(unsigned i=0;i<n;i++){
+      const double distance=std::sqrt(distance2[i]);
+      double deriv;
+      const double result=interpolateTable(table,d0,tableDelta,tableInvDelta,distance,deriv);
+      const bool below=(distance<=d0);
+      const bool cut=(distance>dmax);
+      value[i]=cut?0.0:(below?plateau:result);
+      dfunc[i]=(cut||below)?0.0:deriv/distance;
+    }
+    return;
   }
-  const double rdist = (distance-d0)*invr0;
-  double result;
+  if(type==rational && nn%2==0 && mm%2==0 && d0==0.0){
+// the most common exponents are fixed at compile time
+    if(nn==6 && mm==12) rationalSqrBatch<3>(nn,mm,invr0_2,dmax_2,stretch,shift,distance2,value,dfunc,n);
+    else if(nn==8 && mm==16) rationalSqrBatch<4>(nn,mm,invr0_2,dmax_2,stretch,shift,distance2,value,dfunc,n);
+    else if(nn==12 && mm==24) rationalSqrBatch<6>(nn,mm,invr0_2,dmax_2,stretch,shift,distance2,value,dfunc,n);
+    else rationalSqrBatch<0>(nn,mm,invr0_2,dmax_2,stretch,shift,distance2,value,dfunc,n);
+    return;
+  }
+  const Range range(d0,invr0,dmax,stretch,shift);
+  switch(type){
+    case rational: evaluateBatch(RationalFunction(nn,mm),range,distance2,value,dfunc,n); break;
+    case smap: evaluateBatch(SmapFunction(a,b,c,d),range,distance2,value,dfunc,n); break;
+    case exponential: evaluateBatch(ExponentialFunction(),range,distance2,value,dfunc,n); break;
+    case nativeq: evaluateBatch(NativeQFunction(beta,lambda,ref),range,distance2,value,dfunc,n); break;
+    case gaussian: evaluateBatch(GaussianFunction(),range,distance2,value,dfunc,n); break;
+    case cubic: evaluateBatch(CubicFunction(),range,distance2,value,dfunc,n); break;
+    case tanh: evaluateBatch(TanhFunction(),range,distance2,value,dfunc,n); break;
+#ifdef __PLUMED_HAS_MATHEVAL
+    case matheval: evaluateBatch(MathevalFunction(evaluator,evaluator_deriv),range,distance2,value,dfunc,n); break;
+#endif
+    default: plumed_merror("Unknown switching function type");
+  }
+}
 
-  if(rdist<=0.){
-     result=1.;
-     dfunc=0.0;
-  }else{
-    if(type==smap){
-      double sx=c*pow( rdist, a ); 
-      result=pow( 1.0 + sx, d ); 
-      dfunc=-b*sx/rdist*result/(1.0+sx); 
-    } else if(type==rational){
-      result=do_rational(rdist,dfunc,nn,mm);
-    }else if(type==exponential){
-      result=exp(-rdist);
-      dfunc=-result;
-    }else if(type==nativeq){
-      double rdist2 = beta*(distance - lambda * ref);
-      double exprdist=exp(rdist2);
-      result=1./(1.+exprdist);
-      dfunc=-exprdist/(1.+exprdist)/(1.+exprdist);
-    }else if(type==gaussian){
-      result=exp(-0.5*rdist*rdist);
-      dfunc=-rdist*result;
-    }else if(type==cubic){
-      double tmp1=rdist-1, tmp2=(1+2*rdist);
-      result=tmp1*tmp1*tmp2;
-      dfunc=2*tmp1*tmp2 + 2*tmp1*tmp1;
-    }else if(type==tanh){
-      double tmp1=std::tanh(rdist);
-      result = 1.0 - tmp1;
-      dfunc=-(1-tmp1*tmp1);
+double SwitchingFunction::calculate(double distance,double&dfunc)const{
+  plumed_massert(init,"you are trying to use an unset SwitchingFunction");
+  if(table.size()>0){
+    if(distance>dmax){
+      dfunc=0.0;
+      return 0.0;
+    }
+    if(distance<=d0){
+      dfunc=0.0;
+      return stretch+shift;
+    }
+    double deriv;
+    const double result=interpolateTable(table,d0,tableDelta,tableInvDelta,distance,deriv);
+    dfunc=deriv/distance;
+    return result;
+  }
+  const Range range(d0,invr0,dmax,stretch,shift);
+  switch(type){
+    case rational: return evaluate(RationalFunction(nn,mm),range,distance,dfunc);
+    case smap: return evaluate(SmapFunction(a,b,c,d),range,distance,dfunc);
+    case exponential: return evaluate(ExponentialFunction(),range,distance,dfunc);
+    case nativeq: return evaluate(NativeQFunction(beta,lambda,ref),range,distance,dfunc);
+    case gaussian: return evaluate(GaussianFunction(),range,distance,dfunc);
+    case cubic: return evaluate(CubicFunction(),range,distance,dfunc);
+    case tanh: return evaluate(TanhFunction(),range,distance,dfunc);
 #ifdef __PLUMED_HAS_MATHEVAL
-    }else if(type==matheval){
-      result=evaluator_evaluate_x(evaluator,rdist);
-      dfunc=evaluator_evaluate_x(evaluator_deriv,rdist);
+    case matheval: return evaluate(MathevalFunction(evaluator,evaluator_deriv),range,distance,dfunc);
 #endif
-    }else plumed_merror("Unknown switching function type");
-// this is for the chain rule:
-    dfunc*=invr0;
-// this is because calculate() sets dfunc to the derivative divided times the distance.
-// (I think this is misleading and I would like to modify it - GB)
-    dfunc/=distance;
+    default: plumed_merror("Unknown switching function type");
   }
+  return 0.0;
+}
 
-  result=result*stretch+shift;
-  dfunc*=stretch;
+double SwitchingFunction::calculateUntabulated(double x,double&deriv)const{
+  const double rdist=(x-d0)*invr0;
+  double result=0.0;
+  switch(type){
+    case rational: result=RationalFunction(nn,mm)(rdist,x,deriv); break;
+    case smap: result=SmapFunction(a,b,c,d)(rdist,x,deriv); break;
+    case exponential: result=ExponentialFunction()(rdist,x,deriv); break;
+    case nativeq: result=NativeQFunction(beta,lambda,ref)(rdist,x,deriv); break;
+    case gaussian: result=GaussianFunction()(rdist,x,deriv); break;
+    case cubic: result=CubicFunction()(rdist,x,deriv); break;
+    case tanh: result=TanhFunction()(rdist,x,deriv); break;
+#ifdef __PLUMED_HAS_MATHEVAL
+    case matheval: result=MathevalFunction(evaluator,evaluator_deriv)(rdist,x,deriv); break;
+#endif
+    default: plumed_merror("Unknown switching function type");
+  }
+  deriv*=invr0*stretch;
+  return result*stretch+shift;
+}
 
-  return result;
+void SwitchingFunction::buildTable(std::string& errormsg){
+  table.clear();
+  if(dmax==std::numeric_limits<double>::max()){
+    errormsg="D_MAX is required to tabulate the switching function";
+    return;
+  }
+  if(dmax<=d0){
+    errormsg="D_MAX should be larger than D_0 to tabulate the switching function";
+    return;
+  }
+// the number of intervals is doubled until the error at three points in each interval is small enough
+  for(unsigned n=64;n<=(1u<<22);n*=2){
+    tableDelta=(dmax-d0)/n;
+    tableInvDelta=1.0/tableDelta;
+    std::vector<double> tab(2*(n+1));
+    for(unsigned i=0;i<=n;i++){
+      tab[2*i]=calculateUntabulated(d0+i*tableDelta,tab[2*i+1]);
+// the derivative at d0 is the limit from above, which cannot always be evaluated at d0
+      if(i==0 && !std::isfinite(tab[1])) calculateUntabulated(d0+1e-6*tableDelta,tab[1]);
+    }
+    double errv=0.0, errd=0.0;
+    for(unsigned i=0;i<n;i++) for(unsigned k=1;k<4;k++){
+      const double x=d0+(i+0.25*k)*tableDelta;
+      double deriv,tderiv;
+      const double f=calculateUntabulated(x,deriv);
+      const double tf=interpolateTable(tab,d0,tableDelta,tableInvDelta,x,tderiv);
+      errv=std::max(errv,std::fabs(f-tf));
+      errd=std::max(errd,std::fabs(deriv-tderiv)/invr0);
+    }
+    if(errv<=tableTolerance && errd<=tableTolerance){
+      table.swap(tab);
+      tableValueError=errv;
+      tableDerivError=errd;
+      return;
+    }
+  }
+  errormsg="the switching function cannot be tabulated with the requested accuracy";
 }
 
 SwitchingFunction::SwitchingFunction():
@@ -435,7 +728,12 @@ SwitchingFunction::SwitchingFunction():
   stretch(1.0),
   shift(0.0),
   evaluator(NULL),
-  evaluator_deriv(NULL)
+  evaluator_deriv(NULL),
+  tableTolerance(0.0),
+  tableDelta(0.0),
+  tableInvDelta(0.0),
+  tableValueError(0.0),
+  tableDerivError(0.0)
 {
 }
 
@@ -459,7 +757,13 @@ SwitchingFunction::SwitchingFunction(const SwitchingFunction&sf):
   stretch(sf.stretch),
   shift(sf.shift),
   evaluator(NULL),
-  evaluator_deriv(NULL)
+  evaluator_deriv(NULL),
+  tableTolerance(sf.tableTolerance),
+  tableDelta(sf.tableDelta),
+  tableInvDelta(sf.tableInvDelta),
+  table(sf.table),
+  tableValueError(sf.tableValueError),
+  tableDerivError(sf.tableDerivError)
 {
 #ifdef __PLUMED_HAS_MATHEVAL
   if(sf.evaluator) evaluator=evaluator_create(evaluator_get_string(sf.evaluator));
@@ -478,6 +782,8 @@ void SwitchingFunction::set(int nn,int mm,double r0,double d0){
   this->d0=d0;
   this->dmax=d0+r0*pow(0.00001,1./(nn-mm));
   this->dmax_2=this->dmax*this->dmax;
+  this->tableTolerance=0.0;
+  this->table.clear();
 }
 
 double SwitchingFunction::get_r0() const {
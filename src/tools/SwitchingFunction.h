@@ -23,6 +23,7 @@
 #define __PLUMED_tools_SwitchingFunction_h
 
 #include <string>
+#include <vector>
 
 namespace PLMD {
 
@@ -62,13 +63,23 @@ class SwitchingFunction{
   double dmax_2;
 /// Parameters for stretching the function to zero at d_max
   double stretch,shift;
-/// Low-level tool to compute rational functions.
-/// It is separated since it is called both by calculate() and calculateSqr()
-  double do_rational(double rdist,double&dfunc,int nn,int mm)const;
 /// Evaluator for matheval:
   void* evaluator;
 /// Evaluator for matheval:
   void* evaluator_deriv;
+/// Maximum error allowed in the tabulated function, zero if the function is not tabulated
+  double tableTolerance;
+/// Spacing of the table and its inverse
+  double tableDelta,tableInvDelta;
+/// Value and derivative with respect to the distance at the nodes of the table, interleaved
+  std::vector<double> table;
+/// Largest errors found on the value and on r_0 times the derivative when the table was checked
+  double tableValueError,tableDerivError;
+/// Compute the switching function without cutoff and without the plateau below d0.
+/// Returns s(x) and sets deriv to its derivative. Used to build the table.
+  double calculateUntabulated(double x,double&deriv)const;
+/// Build a table of cubic splines with error smaller than tableTolerance
+  void buildTable(std::string& errormsg);
 public:
   static void registerKeywords( Keywords& keys );
 /// Constructor
@@ -98,6 +109,11 @@ public:
 /// The advantage is that in some case the expensive square root can be avoided
 /// (namely for rational functions, if nn and mm are even and d0 is zero)
   double calculateSqr(double distance2,double&dfunc)const;
+/// Compute the switching function on n squared distances.
+/// Gives the same results as calling calculateSqr() on each of them, but
+/// the type of function is only checked once and the loop over distances
+/// is free of branches, so that it can be vectorized.
+  void calculateSqr(const double*distance2,double*value,double*dfunc,unsigned n)const;
 /// Returns d0
   double get_d0() const;
 /// Returns r0
@@ -135,6 +135,21 @@ public:
 /// Check if a string full starts with string start.
 /// Same as full.find(start)==0
   static bool startWith(const std::string & full,const std::string &start);
+/// Write an object with a trivial memory layout on a binary stream
+  template<typename T>
+  static void writeBinary(std::ostream&,const T&);
+/// Write a vector of objects with a trivial memory layout on a binary stream, preceded by its size
+  template<typename T>
+  static void writeBinary(std::ostream&,const std::vector<T>&);
+/// Write a string on a binary stream, preceded by its size
+  static void writeBinary(std::ostream&,const std::string&);
+/// Read an object written with writeBinary().
+/// Errors are reported through the state of the stream
+  template<typename T>
+  static void readBinary(std::istream&,T&);
+  template<typename T>
+  static void readBinary(std::istream&,std::vector<T>&);
+  static void readBinary(std::istream&,std::string&);
 };
 
 template <class T>
@@ -205,6 +220,46 @@ void Tools::convert(T i,std::string & str){
         str=ostr.str();
 }
 
+template<typename T>
+void Tools::writeBinary(std::ostream&o,const T&t){
+  o.write(reinterpret_cast<const char*>(&t),sizeof(T));
+}
+
+template<typename T>
+void Tools::writeBinary(std::ostream&o,const std::vector<T>&v){
+  writeBinary(o,static_cast<unsigned long long>(v.size()));
+  if(v.size()>0) o.write(reinterpret_cast<const char*>(&v[0]),v.size()*sizeof(T));
+}
+
+inline
+void Tools::writeBinary(std::ostream&o,const std::string&s){
+  writeBinary(o,static_cast<unsigned long long>(s.size()));
+  o.write(s.c_str(),s.size());
+}
+
+template<typename T>
+void Tools::readBinary(std::istream&i,T&t){
+  i.read(reinterpret_cast<char*>(&t),sizeof(T));
+}
+
+template<typename T>
+void Tools::readBinary(std::istream&i,std::vector<T>&v){
+  unsigned long long n=0;
+  readBinary(i,n);
+  if(!i) return;
+  v.resize(n);
+  if(n>0) i.read(reinterpret_cast<char*>(&v[0]),n*sizeof(T));
+}
+
+inline
+void Tools::readBinary(std::istream&i,std::string&s){
+  unsigned long long n=0;
+  readBinary(i,n);
+  if(!i) return;
+  s.resize(n);
+  if(n>0) i.read(&s[0],n);
+}
+
 inline
 double Tools::fastpow(double base, int exp)
 {
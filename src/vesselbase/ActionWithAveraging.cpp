@@ -121,6 +121,14 @@ void ActionWithAveraging::update(){
   }
 }
 
+void ActionWithAveraging::writeCheckpoint( std::ostream& o ) const {
+  if( myaverage ) myaverage->writeBinary( o );
+}
+
+void ActionWithAveraging::readCheckpoint( std::istream& i ){
+  if( myaverage ) myaverage->readBinary( i );
+}
+
 void ActionWithAveraging::clearAverage(){ plumed_assert( myaverage->wasreset() ); myaverage->clear(); }
 
 void ActionWithAveraging::performOperations( const bool& from_update ){ plumed_error(); }
@@ -87,6 +87,9 @@ public:
   virtual void performOperations( const bool& from_update );
 /// This is done once the averaging is finished
   virtual void finishAveraging(){}
+/// Save and restore the accumulated averages
+  void writeCheckpoint( std::ostream& ) const ;
+  void readCheckpoint( std::istream& );
 };
 
 inline
@@ -30,6 +30,9 @@
 #include "StoreDataVessel.h"
 #include "tools/OpenMP.h"
 #include "tools/Stopwatch.h"
+#include "tools/Profiler.h"
+#include "core/PlumedMain.h"
+#include <algorithm>
 
 using namespace std;
 namespace PLMD{
@@ -252,15 +255,79 @@ unsigned ActionWithVessel::getSizeOfBuffer( unsigned& bufsize ){
   return bufsize;
 }
 
+/// Size of the blocks in which the buffers are split when they are summed over the processes
+static const unsigned sparseBlock=512;
+
+/// Set the elements of mask to one for the blocks of v that contain non-zero elements
+template <class T>
+static void markNonZeroBlocks( const std::vector<T>& v, unsigned* mask ){
+  const unsigned nblocks=( v.size() + sparseBlock - 1 ) / sparseBlock;
+  for(unsigned b=0;b<nblocks;++b){
+      mask[b]=0; const unsigned iend=std::min( unsigned(v.size()), (b+1)*sparseBlock );
+      for(unsigned i=b*sparseBlock;i<iend;++i){ if( v[i]!=T(0) ){ mask[b]=1; break; } }
+  }
+}
+
+/// Class for summing a vector over the processes, only sending the blocks that are
+/// non-zero on at least one process. The sum is started with a non-blocking call, so
+/// that other work can be done before it is completed.
+template <class T>
+class SparseSum {
+  std::vector<T>* v;
+/// Blocks that are non-zero on at least one process
+  std::vector<unsigned> blocks;
+/// Non-zero blocks copied contiguously
+  std::vector<T> packed;
+  bool started, dense;
+  Communicator::Request req;
+public:
+  SparseSum(): v(NULL), started(false), dense(false) {}
+/// Start the sum. mask contains the number of processes on which each block is non-zero
+  void start( Communicator& comm, std::vector<T>& vec, const unsigned* mask ){
+    v=&vec; 
+    const unsigned nblocks=( v->size() + sparseBlock - 1 ) / sparseBlock;
+    for(unsigned b=0;b<nblocks;++b) if( mask[b]>0 ) blocks.push_back(b);
+    if( blocks.size()==0 ) return;
+    started=true;
+    // When most blocks are needed it is cheaper to send the whole vector
+    dense=( 4*blocks.size() > 3*nblocks );
+    if( dense ){ req=comm.Isum( *v ); return; }
+    packed.reserve( blocks.size()*sparseBlock );
+    for(const auto & b : blocks){
+        const unsigned iend=std::min( unsigned(v->size()), (b+1)*sparseBlock );
+        packed.insert( packed.end(), v->begin()+b*sparseBlock, v->begin()+iend );
+    }
+    req=comm.Isum( packed );
+  }
+/// Complete the sum, if it was started
+  void wait(){
+    if( !started ) return;
+    req.wait(); started=false;
+    if( dense ) return;
+    unsigned k=0;
+    for(const auto & b : blocks){
+        const unsigned iend=std::min( unsigned(v->size()), (b+1)*sparseBlock );
+        for(unsigned i=b*sparseBlock;i<iend;++i) (*v)[i]=packed[k++];
+    }
+  }
+};
+
 void ActionWithVessel::runAllTasks(){
   plumed_massert( !contributorsAreUnlocked && functions.size()>0, "you must have a call to readVesselKeywords somewhere" );
   unsigned stride=comm.Get_size();
   unsigned rank=comm.Get_rank();
   if(serial){ stride=1; rank=0; }
 
+  // Stages are also recorded by the profiler, below the timer of this action
+  Profiler* profiler=plumed.profiler;
+  std::string profilerPath;
+  if(profiler) profilerPath=profiler->getPhase()+"/"+getLabel()+"/";
+
   // Make sure jobs are done
   if(timers) stopwatch.start("1 Prepare Tasks");
+  if(profiler) profiler->start(profilerPath+"Prepare tasks");
   doJobsRequiredBeforeTaskList();
+  if(profiler) profiler->stop(profilerPath+"Prepare tasks");
   if(timers) stopwatch.stop("1 Prepare Tasks");
 
   // Get number of threads for OpenMP
@@ -281,10 +348,14 @@ void ActionWithVessel::runAllTasks(){
   // std::vector<double> buffer( bufsize, 0.0 );
 
   if(timers) stopwatch.start("2 Loop over tasks");
+  if(profiler) profiler->start(profilerPath+"Loop over tasks");
+  // Buffers of the threads that did some work, they are summed in parallel at the end of the loop
+  std::vector<const double*> thread_buffers( nt, NULL );
 #pragma omp parallel num_threads(nt)
 {
   std::vector<double> omp_buffer;
   if( nt>1 ) omp_buffer.resize( bufsize, 0.0 );
+  bool omp_used=false;
   MultiValue myvals( getNumberOfQuantities(), getNumberOfDerivatives() );
   MultiValue bvals( getNumberOfQuantities(), getNumberOfDerivatives() );
   myvals.clearAll(); bvals.clearAll();
@@ -307,7 +378,7 @@ void ActionWithVessel::runAllTasks(){
       // If the contribution of this quantity is very small at neighbour list time ignore it
       // untill next neighbour list time
       if( nt>1 ){
-          calculateAllVessels( indexOfTaskInFullList[i], myvals, bvals, omp_buffer, der_list );
+          calculateAllVessels( indexOfTaskInFullList[i], myvals, bvals, omp_buffer, der_list ); omp_used=true;
       } else {
           calculateAllVessels( indexOfTaskInFullList[i], myvals, bvals, buffer, der_list );
       }
@@ -315,26 +386,59 @@ void ActionWithVessel::runAllTasks(){
       // Clear the value
       myvals.clearAll();
   }
-#pragma omp critical
-  if(nt>1) for(unsigned i=0;i<bufsize;++i) buffer[i]+=omp_buffer[i];
+  if( nt>1 ){
+     if( omp_used && bufsize>0 ) thread_buffers[OpenMP::getThreadNum()]=&omp_buffer[0];
+#pragma omp barrier
+     // Each thread sums one slice of all the buffers. Slices are aligned to cache lines and
+     // buffers are summed in the order of the threads, so that the result is reproducible
+     const unsigned nteam=OpenMP::getNumThreadsInTeam(), line=OpenMP::getCachelineSize()/sizeof(double);
+     unsigned slice=( bufsize + nteam - 1 ) / nteam; 
+     if( line>0 ) slice=( ( slice + line - 1 ) / line )*line;
+     const unsigned istart=std::min( bufsize, OpenMP::getThreadNum()*slice ), iend=std::min( bufsize, istart + slice );
+     for(unsigned t=0;t<thread_buffers.size();++t){
+        const double* tbuf=thread_buffers[t]; 
+        if( !tbuf ) continue;
+        for(unsigned i=istart;i<iend;++i) buffer[i]+=tbuf[i];
+     }
+     // Buffers cannot be released before all threads are done with them
+#pragma omp barrier
+  }
 }
+  if(profiler) profiler->stop(profilerPath+"Loop over tasks");
   if(timers) stopwatch.stop("2 Loop over tasks");
   // Turn back on derivative calculation
   dertime=true;
 
   if(timers) stopwatch.start("3 MPI gather");
+  if(profiler) profiler->start(profilerPath+"MPI gather");
   // MPI Gather everything
-  if( !serial && buffer.size()>0 ) comm.Sum( buffer );
-  // MPI Gather index stores
-  if( mydata && !lowmem && !noderiv ){ 
-     comm.Sum( der_list ); mydata->setActiveValsAndDerivatives( der_list ); 
+  const bool sumBuffer=( !serial && buffer.size()>0 ), sumDerList=( mydata && !lowmem && !noderiv );
+  if( comm.Get_size()>1 && ( sumBuffer || sumDerList ) ){
+     // Find the blocks of the buffer and of the index stores that are non-zero on some process
+     const unsigned nbuf=( sumBuffer ? ( buffer.size() + sparseBlock - 1 ) / sparseBlock : 0 );
+     const unsigned nder=( sumDerList ? ( der_list.size() + sparseBlock - 1 ) / sparseBlock : 0 );
+     std::vector<unsigned> mask( nbuf + nder + 1, 0 );
+     if( sumBuffer ) markNonZeroBlocks( buffer, &mask[0] );
+     if( sumDerList ) markNonZeroBlocks( der_list, &mask[nbuf] );
+     comm.Sum( mask );
+     // Start both sums, so that the index stores can be used while the buffer is being summed
+     SparseSum<double> bufferSum; SparseSum<unsigned> derSum;
+     if( sumBuffer ) bufferSum.start( comm, buffer, &mask[0] );
+     if( sumDerList ) derSum.start( comm, der_list, &mask[nbuf] );
+     if( sumDerList ){ derSum.wait(); mydata->setActiveValsAndDerivatives( der_list ); }
+     bufferSum.wait();
+  } else if( sumDerList ){
+     mydata->setActiveValsAndDerivatives( der_list );
   }
   // Update the elements that are makign contributions to the sum here
   // this causes problems if we do it in prepare
+  if(profiler) profiler->stop(profilerPath+"MPI gather");
   if(timers) stopwatch.stop("3 MPI gather");
 
   if(timers) stopwatch.start("4 Finishing computations");
+  if(profiler) profiler->start(profilerPath+"Finishing computations");
   finishComputations( buffer );
+  if(profiler) profiler->stop(profilerPath+"Finishing computations");
   if(timers) stopwatch.stop("4 Finishing computations");
 }
 
@@ -53,6 +53,18 @@ void AveragingVessel::reset(){
   wascleared=true; 
 }
 
+void AveragingVessel::writeBinary( std::ostream& o ) const {
+  Tools::writeBinary( o, wascleared ); Tools::writeBinary( o, data );
+}
+
+void AveragingVessel::readBinary( std::istream& i ){
+  std::vector<double> newdata;
+  Tools::readBinary( i, wascleared ); Tools::readBinary( i, newdata );
+  if( !i ) return;
+  plumed_massert( newdata.size()==data.size(), "averaged data in the checkpoint are not consistent with the input of action " + getAction()->getLabel() );
+  data.swap( newdata );
+}
+
 void AveragingVessel::setDataSize( const unsigned& size ){
   if( data.size()!=(1+size) ) data.resize( 1+size, 0 );
 }
@@ -63,6 +63,10 @@ public:
  void setNorm( const double& snorm );
  double getNorm() const ;
  virtual bool applyForce(  std::vector<double>& forces ){ return false; } 
+/// Write the accumulated data in a binary checkpoint
+ void writeBinary( std::ostream& ) const ;
+/// Read the accumulated data written by writeBinary()
+ void readBinary( std::istream& );
 };
 
 inline
@@ -0,0 +1,114 @@
+#include "../../src/tools/Grid.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace PLMD;
+
+// Per-call cost of spline interpolation on grids with 1 to 5 dimensions.
+// Dimensions up to 4 use the specialised kernels, which are compared with
+// the generic algorithm (also used for 5 dimensions) on the same points.
+// Usage: grid-spline [number of calls]
+
+// the generic algorithm of Grid::getValueAndDerivatives(), which is not
+// reachable from outside for grids with up to four dimensions
+class GenericGrid : public Grid {
+public:
+  using Grid::Grid;
+  double generic(const std::vector<double> & x, std::vector<double>& der) const {
+    std::vector<double> fd(dimension_),C(dimension_),D(dimension_),dder(dimension_);
+    double value=0.0;
+    for(unsigned i=0;i<dimension_;++i) der[i]=0.0;
+    std::vector<unsigned> indices=getIndices(x);
+    std::vector<index_t> neigh=getSplineNeighbors(indices);
+    std::vector<double> xfloor=getPoint(x);
+    for(unsigned ipoint=0;ipoint<neigh.size();++ipoint){
+      double grid=Grid::getValueAndDerivatives(neigh[ipoint],dder);
+      std::vector<unsigned> nindices=getIndices(neigh[ipoint]);
+      double ff=1.0;
+      for(unsigned j=0;j<dimension_;++j){
+        int x0=1;
+        if(nindices[j]==indices[j]) x0=0;
+        double dx=getDx()[j];
+        double X=std::fabs((x[j]-xfloor[j])/dx-(double)x0);
+        double X2=X*X;
+        double X3=X2*X;
+        double yy;
+        if(std::fabs(grid)<0.0000001) yy=0.0;
+        else yy=-dder[j]/grid;
+        C[j]=(1.0-3.0*X2+2.0*X3) - (x0?-1.0:1.0)*yy*(X-2.0*X2+X3)*dx;
+        D[j]=( -6.0*X +6.0*X2) - (x0?-1.0:1.0)*yy*(1.0-4.0*X +3.0*X2)*dx;
+        D[j]*=(x0?-1.0:1.0)/dx;
+        ff*=C[j];
+      }
+      for(unsigned j=0;j<dimension_;++j){
+        fd[j]=D[j];
+        for(unsigned i=0;i<dimension_;++i) if(i!=j) fd[j]*=C[i];
+      }
+      value+=grid*ff;
+      for(unsigned j=0;j<dimension_;++j) der[j]+=grid*fd[j];
+    }
+    return value;
+  }
+};
+
+int main(int argc,char**argv){
+  unsigned ncalls=1000000;
+  if(argc>1) ncalls=std::atoi(argv[1]);
+
+  std::printf("%9s %14s %16s %10s %12s\n","dimension","ns/call","generic ns/call","speedup","max diff");
+  for(unsigned dim=1;dim<=5;++dim){
+    std::vector<std::string> names(dim),gmin(dim),gmax(dim),pmin(dim),pmax(dim);
+    std::vector<unsigned> nbin(dim);
+    std::vector<bool> pbc(dim);
+    for(unsigned j=0;j<dim;++j){
+      names[j]="x"+std::to_string(j);
+      pbc[j]=(j%2==0);
+      gmin[j]=pmin[j]="-3.0"; gmax[j]=pmax[j]="3.0";
+      nbin[j]=(dim<5 ? 23-2*dim : 6);
+    }
+    GenericGrid grid("f",names,gmin,gmax,nbin,true,true,true,pbc,pmin,pmax);
+
+    std::vector<double> xx(dim),der(dim),der2(dim);
+    for(Grid::index_t i=0;i<grid.getSize();++i){
+      grid.getPoint(i,xx);
+      double f=1.0;
+      for(unsigned j=0;j<dim;++j) f*=std::cos(0.5*xx[j]+0.1*j)+1.5;
+      for(unsigned j=0;j<dim;++j) der[j]=-0.5*std::sin(0.5*xx[j]+0.1*j)*f/(std::cos(0.5*xx[j]+0.1*j)+1.5);
+      grid.setValueAndDerivatives(i,f,der);
+    }
+
+    double sum=0.0;
+    auto start=std::chrono::high_resolution_clock::now();
+    for(unsigned n=0;n<ncalls;++n){
+      for(unsigned j=0;j<dim;++j) xx[j]=-2.9+5.8*((n*(2*j+3))%1000)/1000.0;
+      sum+=grid.getValueAndDerivatives(xx,der);
+    }
+    auto stop=std::chrono::high_resolution_clock::now();
+    double ns=std::chrono::duration<double,std::nano>(stop-start).count()/ncalls;
+
+    double sum2=0.0;
+    start=std::chrono::high_resolution_clock::now();
+    for(unsigned n=0;n<ncalls;++n){
+      for(unsigned j=0;j<dim;++j) xx[j]=-2.9+5.8*((n*(2*j+3))%1000)/1000.0;
+      sum2+=grid.generic(xx,der2);
+    }
+    stop=std::chrono::high_resolution_clock::now();
+    double ns2=std::chrono::duration<double,std::nano>(stop-start).count()/ncalls;
+
+// results should be identical up to rounding
+    double diff=0.0;
+    for(unsigned n=0;n<1000;++n){
+      for(unsigned j=0;j<dim;++j) xx[j]=-2.9+5.8*((n*(2*j+3))%1000)/1000.0;
+      diff=std::max(diff,std::fabs(grid.getValueAndDerivatives(xx,der)-grid.generic(xx,der2)));
+      for(unsigned j=0;j<dim;++j) diff=std::max(diff,std::fabs(der[j]-der2[j]));
+    }
+    std::printf("%9u %14.1f %16.1f %10.2f %12.3g\n",dim,ns,ns2,ns2/ns,diff);
+// prevent the loops from being optimized away
+    if(sum!=sum || sum2!=sum2) std::printf("checksum %g %g\n",sum,sum2);
+  }
+  return 0;
+}
@@ -0,0 +1,147 @@
+#include "../../src/tools/File.h"
+#include "../../src/tools/Tools.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace PLMD;
+
+// Time needed to read a large HILLS file with IFile::scanField, compared with
+// the algorithm used before fielded files were tokenized in place: each line is
+// split with Tools::getWords, fields are looked up by name and converted with Tools::convert.
+// Usage: ifile-fields [number of lines]
+
+// the old IFile::advanceField() and IFile::scanField(), reading from a std::ifstream
+class OldReader {
+  struct Field {
+    std::string name,value;
+    bool constant;
+    Field(): constant(false) {}
+  };
+  std::ifstream in;
+  std::vector<Field> fields;
+  bool inMiddleOfField;
+  bool advanceField(){
+    std::string line;
+    while(std::getline(in,line)){
+      std::vector<std::string> words=Tools::getWords(line);
+      if(words.size()>=2 && words[0]=="#!" && words[1]=="FIELDS"){
+        fields.clear();
+        for(unsigned i=2;i<words.size();i++){ Field field; field.name=words[i]; fields.push_back(field); }
+      } else if(words.size()==4 && words[0]=="#!" && words[1]=="SET"){
+        Field field; field.name=words[2]; field.value=words[3]; field.constant=true;
+        fields.push_back(field);
+      } else {
+        unsigned nf=0;
+        for(unsigned i=0;i<fields.size();i++) if(!fields[i].constant) nf++;
+        Tools::trimComments(line);
+        words=Tools::getWords(line);
+        if(words.size()==nf){
+          unsigned j=0;
+          for(unsigned i=0;i<fields.size();i++){
+            if(fields[i].constant) continue;
+            fields[i].value=words[j];
+            j++;
+          }
+          inMiddleOfField=true;
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+public:
+  explicit OldReader(const std::string&path): in(path.c_str()), inMiddleOfField(false) {}
+  bool scanField(const std::string&name,std::string&str){
+    if(!inMiddleOfField && !advanceField()) return false;
+    for(unsigned i=0;i<fields.size();i++) if(fields[i].name==name){ str=fields[i].value; return true; }
+    plumed_merror("field "+name+" not found");
+  }
+  bool scanField(const std::string&name,double&x){
+    std::string str;
+    if(!scanField(name,str)) return false;
+    Tools::convert(str,x);
+    return true;
+  }
+  void scanField(){ inMiddleOfField=false; }
+};
+
+static unsigned long long seed=12345;
+static double rnd(){
+  seed=seed*6364136223846793005ULL+1442695040888963407ULL;
+  return (seed>>11)*(1.0/9007199254740992.0);
+}
+
+int main(int argc,char**argv){
+  unsigned nlines=2000000;
+  if(argc>1) nlines=std::atoi(argv[1]);
+
+// a HILLS file of a metadynamics with two variables
+  {
+    OFile of; of.open("bench-hills");
+    of.addConstantField("multivariate").printField("multivariate","false");
+    for(unsigned i=0;i<nlines;++i){
+      of.fmtField(" %f"); of.printField("time",0.002*i);
+      of.fmtField(" %14.9f"); of.printField("x",(rnd()-0.5)*6.0);
+      of.printField("y",(rnd()-0.5)*6.0);
+      of.printField("sigma_x",0.1+rnd()*1e-3);
+      of.printField("sigma_y",0.1+rnd()*1e-3);
+      of.printField("height",rnd());
+      of.printField("biasf",10.0);
+      of.printField();
+    }
+    of.close();
+  }
+
+  const char* names[]={"time","x","y","sigma_x","sigma_y","height","biasf"};
+  const unsigned nnames=sizeof(names)/sizeof(names[0]);
+
+  std::vector<double> sum(nnames,0.0);
+  unsigned nread=0;
+  auto start=std::chrono::high_resolution_clock::now();
+  {
+    IFile ifile; ifile.open("bench-hills");
+    double v; std::string mv;
+    while(ifile.scanField(names[0],v)){
+      sum[0]+=v;
+      for(unsigned j=1;j<nnames;++j){ ifile.scanField(names[j],v); sum[j]+=v; }
+      ifile.scanField("multivariate",mv);
+      ifile.scanField();
+      nread++;
+    }
+  }
+  auto stop=std::chrono::high_resolution_clock::now();
+  double t=std::chrono::duration<double>(stop-start).count();
+
+  std::vector<double> sumOld(nnames,0.0);
+  unsigned nreadOld=0;
+  start=std::chrono::high_resolution_clock::now();
+  {
+    OldReader ifile("bench-hills");
+    double v; std::string mv;
+    while(ifile.scanField(names[0],v)){
+      sumOld[0]+=v;
+      for(unsigned j=1;j<nnames;++j){ ifile.scanField(names[j],v); sumOld[j]+=v; }
+      ifile.scanField("multivariate",mv);
+      ifile.scanField();
+      nreadOld++;
+    }
+  }
+  stop=std::chrono::high_resolution_clock::now();
+  double tOld=std::chrono::duration<double>(stop-start).count();
+
+  bool same=(nread==nreadOld);
+  for(unsigned j=0;j<nnames;++j) if(sum[j]!=sumOld[j]) same=false;
+
+  std::printf("lines read:            %u\n",nread);
+  std::printf("IFile::scanField:      %.3f s (%.1f ns per line)\n",t,1e9*t/nread);
+  std::printf("getWords+convert:      %.3f s (%.1f ns per line)\n",tOld,1e9*tOld/nreadOld);
+  std::printf("speedup:               %.2f\n",tOld/t);
+  std::printf("identical results:     %s\n",same?"yes":"no");
+  std::remove("bench-hills");
+  return 0;
+}